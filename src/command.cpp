@@ -0,0 +1,80 @@
+#include <cctype>
+#include <cstring>
+
+#include "command.hpp"
+
+// Commands whose output only depends on where the inferior is stopped and
+// that leave it untouched, so their replies can be reused until it moves.
+// "list" is left out because it moves GDB's place in the source.
+static const char * cacheable_commands[] = {
+  "info ", "output ", "ptype ", "whatis ", "disassemble", "show ", "where",
+  "bt", "backtrace", nullptr
+};
+
+// Commands that set the value history or $_ and $__ as they print, so each
+// one has to reach GDB; "info line" and "info breakpoints" set $_ too.
+static const char * recording_commands[] = {
+  "p ", "p/", "print ", "print/", "x ", "x/", "info line", "info b", nullptr
+};
+
+// Commands that list the value history or the convenience variables.
+static const char * history_commands[] = {
+  "show val", "show conv", nullptr
+};
+
+// Commands that leave the inferior untouched but aren't worth caching.
+static const char * harmless_commands[] = {
+  "help", "list", "echo", "apropos", nullptr
+};
+
+// Helper function for determining if a command starts with any of the prefixes.
+static bool starts_with_any(const char * command, const char ** prefixes) {
+  while (isspace(*command)) {
+    command++;
+  }
+  for (size_t i = 0; prefixes[i]; i++) {
+    if (!strncmp(command, prefixes[i], strlen(prefixes[i]))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool command_has_side_effects(const char * expression) {
+  for (const char * c = expression; *c; c++) {
+    // <= and >= compare, but <<= and >>= shift in place
+    bool compares = c != expression && strchr("=!<>", c[-1]) &&
+      !(c - 1 != expression && (c[-1] == '<' || c[-1] == '>') && c[-2] == c[-1]);
+    bool assigns = *c == '=' && c[1] != '=' && !compares;
+    bool steps = (*c == '+' && c[1] == '+') || (*c == '-' && c[1] == '-');
+    bool calls = *c == '(' && c != expression && (isalnum(c[-1]) || c[-1] == '_');
+    if (assigns || steps || calls) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool command_reads_history(const char * command) {
+  // Registers and variables the user set start with a letter; history and
+  // GDB's own variables start with anything else
+  for (const char * c = strchr(command, '$'); c; c = strchr(c + 1, '$')) {
+    if (!isalpha(c[1])) {
+      return true;
+    }
+  }
+  return starts_with_any(command, history_commands);
+}
+
+bool command_is_cacheable(const char * command) {
+  return starts_with_any(command, cacheable_commands) && 
+    !starts_with_any(command, recording_commands) &&
+    !command_has_side_effects(command) && !command_reads_history(command);
+}
+
+bool command_is_harmless(const char * command) {
+  bool inspects = starts_with_any(command, cacheable_commands) || 
+    starts_with_any(command, recording_commands);
+  return (inspects && !command_has_side_effects(command)) || 
+    starts_with_any(command, harmless_commands);
+}
@@ -0,0 +1,21 @@
+#ifndef GG_COMMAND_HPP
+#define GG_COMMAND_HPP
+
+// Returns true if an expression may change the inferior, i.e. if it 
+// assigns, increments, decrements or calls a function.
+bool command_has_side_effects(const char * expression);
+
+// Returns true if a command reads the value history ($, $$, $N) or a 
+// convenience variable GDB sets by itself ($_, $__, ...), which print and
+// x change without changing the inferior.
+bool command_reads_history(const char * command);
+
+// Returns true if a CLI command's reply only depends on where the inferior
+// is stopped, so it can be reused until the inferior moves.
+bool command_is_cacheable(const char * command);
+
+// Returns true if a CLI command can't change the inferior, so the replies
+// cached before it are still good after it.
+bool command_is_harmless(const char * command);
+
+#endif
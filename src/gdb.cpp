@@ -1,7 +1,18 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
-
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "command.hpp"
 #include "gg.hpp" 
 
 #ifdef __arm__
@@ -41,17 +52,609 @@ std::vector<std::string> split(const std::string &s, char delim) {
     return elems;
 }
 
-GDB::GDB(std::vector<std::string> args) : 
-  process("gdb", args, 
+// Helper function for determining if an MI query's reply can be reused; 
+// gg only queries over MI, but CLI commands may be run through it.
+static bool is_cacheable_mi(const std::string & command) {
+  return command[0] == '-' && command.compare(0, strlen(GDB_MI_CONSOLE), GDB_MI_CONSOLE) &&
+    !command_reads_history(command.c_str());
+}
+
+// Helper function for formatting variables the way "info locals" does.
+std::string format_variables(const std::vector<MIVariable> & variables, const char * empty) {
+  if (variables.empty()) {
+    return std::string(empty) + "\n";
+  }
+
+  std::string text;
+  for (size_t i = 0; i < variables.size(); i++) {
+    text.append(variables[i].name).append(" = ").append(variables[i].value).append("\n");
+  }
+  return text;
+}
+
+// Helper function for picking the lines of a dump centered on the executing one.
+std::string frame_window(const std::vector<std::string> & lines, int executing_line) {
+  // Concise string that we want to return
+  std::string window;
+  // Relevant starting line in the dump; the first line is a header
+  int starting_line = std::max(1, executing_line - GG_FRAME_LINES / 2);
+  // Relevant ending line in the dump
+  int ending_line = starting_line + GG_FRAME_LINES;
+
+  // Iterate through all relevant lines and append each to output 
+  for (int i = starting_line; i < ending_line; i++) {
+    if (i < lines.size()) {
+      window.append(lines[i]).append("\n");
+    }
+  }
+
+  return window;
+}
+
+// Helper function for finding the index of the instruction at an address,
+// or -1 if no instruction starts there.
+long find_instruction(const std::vector<MIInstruction> & instructions, unsigned long address) {
+  // Instructions are in order, so the one wanted is found by bisection
+  std::vector<MIInstruction>::const_iterator instruction = std::lower_bound(
+      instructions.begin(), instructions.end(), address, 
+      [](const MIInstruction & instruction, unsigned long address) {
+        return instruction.address < address;
+      });
+  return instruction != instructions.end() && instruction->address == address ?
+    instruction - instructions.begin() : -1;
+}
+
+// Helper function for determining if a run holds a full window of 
+// instructions centered on the one at index.
+bool has_window(const GDBDisassembly & run, long index) {
+  return index >= GG_FRAME_LINES / 2 && 
+    (long) run.instructions.size() - index > GG_FRAME_LINES / 2;
+}
+
+// Helper function for laying out a window of instructions the way 
+// "disassemble" does, starting at the given one and marking the one at 
+// the program counter. Only the lines in the window are laid out.
+std::string format_assembly(const std::vector<MIInstruction> & instructions, 
+    long first, unsigned long program_counter) 
+{
+  long last = std::min((long) instructions.size(), first + GG_FRAME_LINES);
+  std::string window;
+  for (long i = first; i < last; i++) {
+    const MIInstruction & instruction = instructions[i];
+
+    // Code outside of any function has no offset to show
+    char prefix[64];
+    int length = snprintf(prefix, sizeof(prefix), "%s0x%0*lx", 
+        instruction.address == program_counter ? "=> " : "   ", 
+        (int) sizeof(void *) * 2, instruction.address);
+    if (!instruction.function.empty()) {
+      snprintf(prefix + length, sizeof(prefix) - length, " <+%ld>", instruction.offset);
+    }
+    window.append(prefix).append(":\t").append(instruction.instruction).append("\n");
+  }
+
+  return window;
+}
+
+// Names GDB knows each group of registers by.
+static const char * register_group_names[GDB_GROUP_COUNT] = { "float", "vector", "system" };
+
+// Helper function for laying out a vector register's raw value as lanes of
+// each integer and floating point width, lowest lane first.
+std::string format_lanes(const std::string & raw) {
+  // The raw value is printed most significant byte first
+  std::vector<unsigned char> bytes;
+  size_t digits = raw.compare(0, 2, "0x") ? 0 : 2;
+  for (size_t end = raw.size(); end >= digits + 2; end -= 2) {
+    bytes.push_back(strtoul(raw.substr(end - 2, 2).c_str(), nullptr, 16));
+  }
+
+  static const struct {
+    const char * name;
+    size_t size;
+    bool floating;
+  } lanes[] = {
+    { "i8", 1, false }, { "i16", 2, false }, { "i32", 4, false }, 
+    { "i64", 8, false }, { "f32", 4, true }, { "f64", 8, true }
+  };
+
+  std::string text;
+  for (size_t i = 0; i < sizeof(lanes) / sizeof(lanes[0]); i++) {
+    text.append("  ").append(lanes[i].name).append(lanes[i].size == 1 ? "   {" : "  {");
+    for (size_t offset = 0; offset + lanes[i].size <= bytes.size(); offset += lanes[i].size) {
+      // Lanes are little-endian, like the x86 registers they come from
+      unsigned long long bits = 0;
+      for (size_t byte = lanes[i].size; byte-- > 0;) {
+        bits = bits << 8 | bytes[offset + byte];
+      }
+
+      char lane[32];
+      if (lanes[i].floating && lanes[i].size == 4) {
+        float value;
+        uint32_t narrow = bits;
+        memcpy(&value, &narrow, sizeof(value));
+        snprintf(lane, sizeof(lane), "%g", value);
+      }
+      else if (lanes[i].floating) {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        snprintf(lane, sizeof(lane), "%g", value);
+      }
+      else {
+        // Sign-extend the lane
+        int shift = 64 - 8 * lanes[i].size;
+        snprintf(lane, sizeof(lane), "%lld", (long long) (bits << shift) >> shift);
+      }
+      text.append(offset ? ", " : "").append(lane);
+    }
+    text.append("}\n");
+  }
+  return text;
+}
+
+// Helper function for the command disassembling the addresses from begin
+// up to end, either of which may be an expression.
+std::string disassemble_command(const std::string & begin, const std::string & end) {
+  return std::string(GDB_MI_DISASSEMBLE_RANGE " -s ") + begin + " -e " + end + " -- 0";
+}
+
+// Helper function for the command disassembling a window around the 
+// program counter without knowing where it is.
+std::string disassemble_window_command() {
+  return disassemble_command(GDB_PROGRAM_COUNTER "-" + std::to_string(GG_DISASSEMBLY_BEHIND), 
+      GDB_PROGRAM_COUNTER "+" + std::to_string(GG_DISASSEMBLY_AHEAD));
+}
+
+std::string format_register(const GDBRegister & reg) {
+  std::string row = reg.name;
+  row.resize(std::max(row.size() + 1, (size_t) 15), ' ');
+  row.append(reg.raw);
+  row.resize(std::max(row.size() + 1, (size_t) 34), ' ');
+  return row.append(reg.natural);
+}
+
+// Helper function for laying out registers one per line.
+std::string format_registers(const std::vector<GDBRegister> & registers) {
+  if (registers.empty()) {
+    return std::string(GDB_NO_REGISTERS);
+  }
+
+  std::string text;
+  for (size_t i = 0; i < registers.size(); i++) {
+    text.append(format_register(registers[i])).append("\n");
+  }
+  return text;
+}
+
+// Helper function for making a StackFrame out of the memory read from the
+// stack pointer up, which it takes the bytes of.
+std::unique_ptr<StackFrame> make_stack_frame(unsigned long stack_pointer, 
+    unsigned long frame_pointer, MIMemory & memory)
+{
+  if (memory.contents.empty()) {
+    return nullptr;
+  }
+
+  std::unique_ptr<StackFrame> stack_frame(new StackFrame());
+  stack_frame->stack_pointer = stack_pointer;
+  stack_frame->frame_pointer = frame_pointer;
+  stack_frame->memory.swap(memory.contents);
+  return stack_frame;
+}
+
+// Helper function for reading a number out of a process's status, e.g. 
+// "TracerPid:" or "PPid:"; -1 if it can't be told.
+long find_status_value(long pid, const char * field) {
+  std::string path = "/proc/" + std::to_string(pid) + "/status";
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  char status[4096];
+  ssize_t length = read(fd, status, sizeof(status) - 1);
+  close(fd);
+  if (length <= 0) {
+    return -1;
+  }
+  status[length] = '\0';
+  const char * value = strstr(status, field);
+  return value ? strtol(value + strlen(field), nullptr, 10) : -1;
+}
+
+// Helper function for finding the process id in the output of "info 
+// program", e.g. "Using the running image of child process 1234." or
+// "... of child Thread 0x7ffff7d85740 (LWP 1234).", 0 if there is none.
+long find_program_pid(const std::string & program_status) {
+  size_t index = program_status.find("(LWP ");
+  if (index != std::string::npos) {
+    return strtol(program_status.c_str() + index + strlen("(LWP "), nullptr, 10);
+  }
+  index = program_status.find("process ");
+  if (index != std::string::npos) {
+    return strtol(program_status.c_str() + index + strlen("process "), nullptr, 10);
+  }
+  return 0;
+}
+
+// Helper function for the command reading a stack frame's memory.
+std::string read_stack_command(unsigned long stack_pointer, unsigned long frame_pointer) {
+  return std::string(GDB_MI_READ_MEMORY " ") + std::to_string(stack_pointer) + " " + 
+    std::to_string(frame_pointer - stack_pointer + ADDITIONAL_STACK_SPACE);
+}
+
+// Helper function for the command evaluating an expression to an address;
+// casting makes GDB print a plain number instead of a typed pointer. The
+// expression is parenthesized so the cast applies to all of it, e.g. to
+// buf + 16 rather than to buf alone.
+std::string evaluate_address_command(const char * expression) {
+  return std::string(GDB_MI_EVALUATE " ") + 
+    mi_quote(std::string("(unsigned long) (") + expression + ")");
+}
+
+GDBReadBuffer::GDBReadBuffer(size_t initial_capacity) :
+  data((char *) malloc(initial_capacity)),
+  capacity(initial_capacity),
+  begin(0),
+  end(0) {}
+
+GDBReadBuffer::~GDBReadBuffer() {
+  free(data);
+}
+
+char * GDBReadBuffer::reserve(size_t minimum, size_t & length, GDBIOStats & stats) {
+  if (capacity - end < minimum) {
+    // Slide the pending bytes to the front to reclaim consumed space
+    if (begin) {
+      memmove(data, data + begin, end - begin);
+      end -= begin;
+      begin = 0;
+    }
+
+    // Only a record bigger than the whole buffer needs more memory
+    if (capacity - end < minimum) {
+      while (capacity - end < minimum) {
+        capacity *= 2;
+      }
+      data = (char *) realloc(data, capacity);
+      stats.allocations++;
+    }
+  }
+
+  length = capacity - end;
+  return data + end;
+}
+
+GDBByteQueue::GDBByteQueue(size_t capacity) : 
+  data((char *) malloc(capacity)),
+  capacity(capacity),
+  head(0),
+  tail(0),
+  closed(false) {}
+
+GDBByteQueue::~GDBByteQueue() {
+  free(data);
+}
+
+char * GDBByteQueue::free_space(size_t & length) {
+  // Positions only grow, so they are wrapped into the ring when used
+  size_t position = head.load(std::memory_order_relaxed);
+  size_t used = position - tail.load(std::memory_order_acquire);
+  size_t offset = position & (capacity - 1);
+  length = std::min(capacity - used, capacity - offset);
+  return data + offset;
+}
+
+size_t GDBByteQueue::pop(char * destination, size_t length, bool & was_full) {
+  size_t position = tail.load(std::memory_order_relaxed);
+  size_t available = head.load(std::memory_order_acquire) - position;
+  size_t popped = std::min(available, length);
+
+  // The used space may wrap around the end of the ring
+  size_t offset = position & (capacity - 1);
+  size_t first_length = std::min(popped, capacity - offset);
+  memcpy(destination, data + offset, first_length);
+  memcpy(destination + first_length, data, popped - first_length);
+
+  tail.store(position + popped, std::memory_order_release);
+  was_full = available == capacity;
+  return popped;
+}
+
+GDBPromptMatcher::GDBPromptMatcher(const char * prompt) : 
+  prompt(prompt), 
+  fallback(strlen(prompt) + 1, 0) 
+{
+  // Standard KMP failure function: longest proper border of each prefix
+  for (size_t i = 1, border = 0; i < this->prompt.size(); i++) {
+    while (border && this->prompt[i] != this->prompt[border]) {
+      border = fallback[border];
+    }
+    if (this->prompt[i] == this->prompt[border]) {
+      border++;
+    }
+    fallback[i + 1] = border;
+  }
+
+  reset();
+}
+
+void GDBPromptMatcher::reset() {
+  matched = 0;
+  at_boundary = true;
+  match_anchored = false;
+}
+
+bool GDBPromptMatcher::feed(const char * data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    char c = data[i];
+
+    // A complete match continues like a partial one of its border length
+    if (matched == prompt.size()) {
+      matched = fallback[matched];
+    }
+
+    // Fall back along the borders until the character extends a match
+    while (matched && c != prompt[matched]) {
+      matched = fallback[matched];
+      match_anchored = false;
+    }
+
+    if (c == prompt[matched]) {
+      // Remember where a fresh match started
+      if (!matched) {
+        match_anchored = at_boundary;
+      }
+      matched++;
+    }
+
+    // Lines start after newlines and after prompts
+    at_boundary = c == '\n' || matched == prompt.size();
+  }
+
+  return matched == prompt.size();
+}
+
+GDBSourceFile::~GDBSourceFile() {
+  close();
+}
+
+bool GDBSourceFile::open(const std::string & path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) == -1 || !S_ISREG(status.st_mode)) {
+    ::close(fd);
+    return false;
+  }
+
+  // Small files are copied, so truncating them on disk can't fault the 
+  // GUI; a file shrinking while it is read just ends early
+  size = status.st_size;
+  if (size && size < GG_SOURCE_MAP_SIZE) {
+    copy.resize(size);
+    size_t copied = 0;
+    while (copied < size) {
+      ssize_t length = read(fd, &copy[copied], size - copied);
+      if (length < 0 && errno == EINTR) {
+        continue;
+      }
+      if (length <= 0) {
+        break;
+      }
+      copied += length;
+    }
+    copy.resize(copied);
+    size = copied;
+    data = size ? copy.data() : nullptr;
+  }
+
+  // Empty files can't be mapped but are fine otherwise
+  else if (size) {
+    void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      ::close(fd);
+      size = 0;
+      return false;
+    }
+    data = (const char *) mapping;
+    mapped = true;
+  }
+  ::close(fd);
+  modified_time = status.st_mtime;
+
+  // memchr skips over the text a word or a vector at a time, so indexing 
+  // costs little more than touching the pages once
+  line_offsets.push_back(0);
+  for (const char * c = data, * end = data + size; c < end; c++) {
+    c = (const char *) memchr(c, '\n', end - c);
+    if (!c) {
+      break;
+    }
+    line_offsets.push_back(c + 1 - data);
+  }
+
+  // A last line without a newline still counts
+  if (line_offsets.back() != size) {
+    line_offsets.push_back(size);
+  }
+
+  // Only the first byte of a UTF-8 sequence takes a column
+  columns = 0;
+  for (long line = 1; line <= get_line_count(); line++) {
+    size_t length;
+    const char * text = get_line(line, length);
+    size_t column = 0;
+    for (size_t i = 0; i < length; i++) {
+      column += text[i] == '\t' ? GG_TAB_WIDTH - column % GG_TAB_WIDTH : (text[i] & 0xc0) != 0x80;
+    }
+    columns = std::max(columns, column);
+  }
+  return true;
+}
+
+bool GDBSourceFile::is_stale(const std::string & path) const {
+  struct stat status;
+  return stat(path.c_str(), &status) == -1 || (size_t) status.st_size != size || 
+    status.st_mtime != modified_time;
+}
+
+const char * GDBSourceFile::get_line(long line, size_t & length) const {
+  if (line < 1 || line > get_line_count()) {
+    length = 0;
+    return "";
+  }
+  size_t begin = line_offsets[line - 1];
+  size_t end = line_offsets[line];
+  if (end > begin && data[end - 1] == '\n') {
+    end--;
+  }
+  length = end - begin;
+  return data + begin;
+}
+
+void GDBSourceFile::close() {
+  if (mapped) {
+    munmap((void *) data, size);
+  }
+  copy.clear();
+  mapped = false;
+  data = nullptr;
+  size = 0;
+  columns = 0;
+  line_offsets.clear();
+}
+
+// Opens a pipe used only to wake up a thread; neither end ever blocks.
+static void open_event_pipe(int fds[2]) {
+  if (pipe(fds) < 0) {
+    fds[0] = fds[1] = -1;
+    return;
+  }
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+}
+
+// Wakes up whoever waits on an event pipe. A full pipe already holds a
+// wake-up, so failing to write is fine.
+static void signal_event(int fd) {
+  char byte = 0;
+  ssize_t written = write(fd, &byte, 1);
+  (void) written;
+}
+
+// Clears the wake-ups pending on an event pipe.
+static void clear_event(int fd) {
+  char bytes[64];
+  while (read(fd, bytes, sizeof(bytes)) > 0) {}
+}
+
+// Pipe the SIGCHLD handler writes to, so child exits can be waited on 
+// alongside everything else. The inferior is GDB's child, not ours, so in
+// practice this only hears about GDB.
+static int child_event[2] = { -1, -1 };
+
+static void handle_child_signal(int signal) {
+  int saved_errno = errno;
+  signal_event(child_event[1]);
+  errno = saved_errno;
+}
+
+// Installs the SIGCHLD handler the first time it is needed.
+static void watch_children() {
+  if (child_event[0] >= 0) {
+    return;
+  }
+  open_event_pipe(child_event);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handle_child_signal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigaction(SIGCHLD, &action, nullptr);
+}
+
+// Adds the options needed by the chosen interpreter to GDB's arguments.
+static std::vector<std::string> gdb_arguments(std::vector<std::string> args, 
+    GDBInterpreter interpreter) 
+{
+  if (interpreter == GDB_INTERPRETER_MI) {
+    args.insert(args.begin() + std::min((size_t) 1, args.size()), GDB_MI_INTERPRETER);
+  }
+  return args;
+}
+
+GDB::GDB(std::vector<std::string> args, GDBInterpreter interpreter) : 
+  interpreter(interpreter),
+  process("gdb", gdb_arguments(args, interpreter), 
       redi::pstreams::pstdin | 
       redi::pstreams::pstdout | 
       redi::pstreams::pstderr), 
+  input_fd(GDBPipes::input_fd(process)),
+  output_fd(GDBPipes::output_fd(process)),
+  error_fd(GDBPipes::error_fd(process)),
+  output_queue(GG_OUTPUT_QUEUE_SIZE),
+  error_queue(GG_ERROR_QUEUE_SIZE),
+  stopping(false),
+  process_exited(false),
+  pipe_polls(0),
+  pipe_reads(0),
+  output_data(GG_OUTPUT_BUFFER_SIZE),
+  error_data(GG_ERROR_BUFFER_SIZE),
+  prompt_matcher(GDB_PROMPT),
+  io_stats(),
+  io_stats_polls_start(0),
+  io_stats_reads_start(0),
+  report_io_stats(getenv(GG_IO_STATS_ENV) != nullptr),
+  round_trips(0),
+  mi_token(0),
+  pending_token(-1),
   saved_line_number(0),
   running_reset_flag(false), 
-  running_program(false) {}
+  running_program(false),
+  live_inferiors(0),
+  inferior_pid(0),
+  inferior_checked(false),
+  inferior_local(false),
+  state_changed(false),
+  stopped_line_number(0),
+  stopped_address(0),
+  assembly_top(0),
+  assembly_marker(0),
+  stop_generation(0),
+  cache_hits(0),
+  cache_misses(0),
+  reply_cached(false),
+  capturing_reply(false),
+  capture_failed(false) 
+{
+  // GDB's output is read on its own thread as soon as it is written, and
+  // its exit noticed the moment it happens
+  watch_children();
+  open_event_pipe(output_event);
+  open_event_pipe(reader_event);
+  reader = std::thread(&GDB::read_pipes, this);
+
+  for (int group = 0; group < GDB_GROUP_COUNT; group++) {
+    group_known[group] = false;
+    group_expanded[group] = false;
+  }
+}
 
   GDB::~GDB() {
+    // The reader thread has to be done with the pipes before they close
+    stopping = true;
+    signal_event(reader_event[1]);
+    reader.join();
     process.close();
+    close(output_event[0]);
+    close(output_event[1]);
+    close(reader_event[0]);
+    close(reader_event[1]);
   }
 
 void GDB::execute(const char * command) {
@@ -59,12 +662,93 @@ void GDB::execute(const char * command) {
 }
 
 void GDB::execute(const char * command, bool set_flags) {
+  reply_cached = false;
+  capturing_reply = false;
   if (is_alive() && command) {
-    // Pass line directly to process
-    process << command << std::endl;
+    // Anything the user does that may change the inferior leaves the 
+    // cached replies stale
+    bool harmless = command_is_harmless(command);
+    if (set_flags && !harmless) {
+      invalidate_cache();
+    }
+
+    // Repeated queries are answered without asking GDB again
+    if (command_is_cacheable(command)) {
+      std::unordered_map<std::string, GDBCachedReply>::iterator entry = reply_cache.find(command);
+      if (entry != reply_cache.end()) {
+        start_io_stats(command);
+        cached_reply = entry->second.output;
+        reply_cached = true;
+        cache_hits++;
+        return;
+      }
+
+      // Keep the reply as it is read
+      cache_misses++;
+      capturing_reply = true;
+      capture_failed = false;
+      capture_command = command;
+      captured_reply.clear();
+    }
 
-    // Mark reset flag for running program
-    running_reset_flag = set_flags;
+    // MI runs CLI commands through the console interpreter under a token
+    if (interpreter == GDB_INTERPRETER_MI) {
+      pending_token = ++mi_token;
+      send(std::to_string(pending_token) + GDB_MI_CONSOLE " " + mi_quote(command), command);
+    }
+    else {
+      send(command, command);
+    }
+
+    // Mark reset flag for running program; harmless commands can't change it
+    running_reset_flag = set_flags && !harmless;
+  }
+}
+
+bool GDB::write_cached_reply(std::ostream & output_buffer) {
+  if (!reply_cached) {
+    return false;
+  }
+  output_buffer << cached_reply << std::flush;
+  reply_cached = false;
+  return true;
+}
+
+void GDB::finish_capture() {
+  if (capturing_reply && !capture_failed) {
+    reply_cache[capture_command].output = captured_reply;
+  }
+  capturing_reply = false;
+}
+
+void GDB::invalidate_cache() {
+  stop_generation++;
+  reply_cache.clear();
+
+  // A reply being read may already be stale
+  capturing_reply = false;
+}
+
+void GDB::send(const std::string & line, const char * command) {
+  // Start counting I/O for this command; each write awaits one reply
+  start_io_stats(command);
+  round_trips++;
+
+  // Pass line directly to process in a single write
+  std::string terminated_line = line + "\n";
+  const char * remaining = terminated_line.data();
+  size_t remaining_length = terminated_line.size();
+  while (remaining_length) {
+    ssize_t written = write(input_fd, remaining, remaining_length);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      break;
+    }
+    io_stats.writes++;
+    remaining += written;
+    remaining_length -= written;
   }
 }
 
@@ -76,11 +760,134 @@ std::string GDB::execute_and_read(const char * command) {
   std::ostringstream buffer;
 
   // Get result of command
-  read_until_prompt(buffer, buffer, true);
+  if (write_cached_reply(buffer)) {
+    print_io_stats();
+  }
+  else if (interpreter == GDB_INTERPRETER_MI) {
+    read_mi_reply(pending_token, buffer, buffer, nullptr, 1, GDB_WAIT_RESULT);
+    pending_token = -1;
+    finish_capture();
+    print_io_stats();
+  }
+  else {
+    read_until_prompt(buffer, buffer, true);
+  }
 
   return buffer.str();
 }
 
+bool GDB::execute_mi(const std::string & command, MIRecord & result) {
+  if (interpreter != GDB_INTERPRETER_MI) {
+    return execute_mi_from_cli(command, result);
+  }
+
+  std::vector<GDBQuery> queries(1);
+  queries[0].command = command;
+  execute_batch(queries);
+
+  result = queries[0].result;
+  return queries[0].succeeded;
+}
+
+bool GDB::execute_mi_from_cli(const std::string & command, MIRecord & result) {
+  // The CLI prints the MI result record as is, among any other output
+  std::string output = execute_and_read(GDB_EXECUTE_MI, mi_quote(command).c_str());
+  size_t start = output.find(MI_RESULT_PREFIX);
+  while (start != std::string::npos && start > 0 && output[start - 1] != '\n') {
+    start = output.find(MI_RESULT_PREFIX, start + 1);
+  }
+  if (start == std::string::npos) {
+    return false;
+  }
+  size_t end = output.find('\n', start);
+  if (end == std::string::npos) {
+    end = output.size();
+  }
+
+  // The record is parsed where records of MI commands are kept
+  mi_arena.reset();
+  char * line = mi_arena.copy(output.data() + start, end - start);
+  result = MIRecord();
+  return mi_parse_record(line, end - start, mi_arena, result) && 
+    result.record_class == MI_CLASS_DONE;
+}
+
+void GDB::execute_batch(std::vector<GDBQuery> & queries) {
+  // Queries without a reply read as failed
+  for (size_t i = 0; i < queries.size(); i++) {
+    queries[i].result = MIRecord();
+    queries[i].result.type = MI_RECORD_PROMPT;
+    queries[i].output.clear();
+    queries[i].succeeded = false;
+    queries[i].cacheable = is_cacheable_mi(queries[i].command);
+    queries[i].record.clear();
+  }
+
+  if (!is_alive() || queries.empty()) {
+    return;
+  }
+
+  // Everything the previous reply was parsed into goes at once
+  mi_arena.reset();
+
+  // Queries repeated since the inferior last moved are answered from the
+  // cache by parsing the kept record again; only the rest are sent
+  std::vector<GDBQuery> sent;
+  std::vector<size_t> sent_indexes;
+  for (size_t i = 0; i < queries.size(); i++) {
+    GDBQuery & query = queries[i];
+    std::unordered_map<std::string, GDBCachedReply>::iterator entry = query.cacheable ? 
+      reply_cache.find(query.command) : reply_cache.end();
+    if (entry == reply_cache.end()) {
+      cache_misses += query.cacheable;
+      sent.push_back(query);
+      sent_indexes.push_back(i);
+      continue;
+    }
+
+    const std::string & record = entry->second.record;
+    char * line = mi_arena.copy(record.data(), record.size());
+    query.succeeded = mi_parse_record(line, record.size(), mi_arena, query.result);
+    query.output = entry->second.output;
+    cache_hits++;
+  }
+
+  if (sent.empty()) {
+    return;
+  }
+
+  // Send every query under consecutive tokens in a single write, so GDB 
+  // works through them back to back while the replies stream in
+  long token = mi_token + 1;
+  std::string lines;
+  for (size_t i = 0; i < sent.size(); i++) {
+    if (i) {
+      lines.append("\n");
+    }
+    lines.append(std::to_string(++mi_token)).append(sent[i].command);
+  }
+  std::string description = sent.size() == 1 ? sent[0].command :
+    std::to_string(sent.size()) + " batched commands";
+  send(lines, description.c_str());
+
+  // Stream output of internal commands isn't meant for the user
+  long generation = stop_generation;
+  std::ostringstream discarded;
+  read_mi_reply(token, discarded, discarded, sent.data(), sent.size(), GDB_WAIT_RESULT);
+  print_io_stats();
+
+  // Replies are only kept if nothing moved while they were read
+  for (size_t i = 0; i < sent.size(); i++) {
+    GDBQuery & query = queries[sent_indexes[i]];
+    query = sent[i];
+    if (query.cacheable && query.succeeded && generation == stop_generation) {
+      GDBCachedReply & reply = reply_cache[query.command];
+      reply.output = query.output;
+      reply.record = query.record;
+    }
+  }
+}
+
 std::string GDB::execute_and_read(const char * command, long arg) {
   // e.g. line = "set listize 10"
   std::string line = std::string(command) + " " + std::to_string(arg);
@@ -106,68 +913,561 @@ std::string GDB::examine_and_read(const char * memory_location,
   return execute_and_read(line.c_str());
 }
 
+void GDB::read_pipes() {
+  GDBByteQueue * queues[2] = { &output_queue, &error_queue };
+  int * pipes[2] = { &output_fd, &error_fd };
+
+  // GDB may have exited before the handler was in place
+  if (check_exited()) {
+    signal_event(output_event[1]);
+  }
+
+  // Once GDB closes its pipes, all that's left is to notice it exit
+  while (!stopping && (output_fd >= 0 || error_fd >= 0 || !process_exited)) {
+    // Pipes whose queue is full are left alone until the consumer makes 
+    // room and wakes us up; negative descriptors are ignored by poll
+    struct pollfd fds[4];
+    char * destinations[2];
+    size_t spaces[2];
+    for (int i = 0; i < 2; i++) {
+      destinations[i] = queues[i]->free_space(spaces[i]);
+      fds[i].fd = spaces[i] ? *pipes[i] : -1;
+      fds[i].events = POLLIN;
+    }
+    fds[2].fd = reader_event[0];
+    fds[2].events = POLLIN;
+    fds[3].fd = child_event[0];
+    fds[3].events = POLLIN;
+
+    // Sleep in the kernel until GDB writes something or exits
+    pipe_polls.fetch_add(1, std::memory_order_relaxed);
+    if (poll(fds, 4, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[2].revents) {
+      clear_event(reader_event[0]);
+    }
+
+    // Hang-ups are reported as readable so the EOF gets consumed by read()
+    bool queued = false;
+    for (int i = 0; i < 2; i++) {
+      if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+        continue;
+      }
+      ssize_t length = read(*pipes[i], destinations[i], spaces[i]);
+      pipe_reads.fetch_add(1, std::memory_order_relaxed);
+      if (length < 0 && (errno == EINTR || errno == EAGAIN)) {
+        continue;
+      }
+
+      // EOF or a broken pipe means GDB will never write here again 
+      if (length <= 0) {
+        *pipes[i] = -1;
+        queues[i]->close();
+      }
+      else {
+        queues[i]->push(length);
+      }
+      queued = true;
+    }
+
+    // Output read in the same pass as the exit is queued before it
+    if (fds[3].revents) {
+      clear_event(child_event[0]);
+      queued = check_exited() || queued;
+    }
+
+    if (queued) {
+      signal_event(output_event[1]);
+    }
+  }
+}
+
+bool GDB::check_exited() {
+  // The consumer only ever looks at the flag, so the reader thread is the
+  // only one touching the process
+  if (process_exited.load(std::memory_order_relaxed) || !process.rdbuf()->exited()) {
+    return false;
+  }
+  process_exited.store(true, std::memory_order_release);
+  return true;
+}
+
+bool GDB::wait_readable(bool & output_ready, bool & error_ready, int timeout_ms) {
+  output_ready = error_ready = false;
+
+  // Nothing to wait on once GDB has closed its output and all of it was read
+  if (output_queue.drained()) {
+    return false;
+  }
+
+  // The reader thread signals after it queues something, so clearing the
+  // signal before looking at the queues can't miss anything
+  clear_event(output_event[0]);
+  if (output_queue.empty() && error_queue.empty()) {
+    struct pollfd fds;
+    fds.fd = output_event[0];
+    fds.events = POLLIN;
+
+    // Sleep in the kernel until the reader thread queues something
+    int ready = poll(&fds, 1, timeout_ms);
+    io_stats.waits++;
+    if (ready < 0) {
+      return errno == EINTR;
+    }
+  }
+
+  output_ready = !output_queue.empty();
+  error_ready = !error_queue.empty();
+  return true;
+}
+
+size_t GDB::read_pipe(GDBByteQueue & queue, GDBReadBuffer & buffer) {
+  size_t space;
+  char * destination = buffer.reserve(GG_READ_MIN_SPACE, space, io_stats);
+  bool was_full;
+  size_t length = queue.pop(destination, space, was_full);
+  io_stats.pops++;
+
+  // The reader thread stops reading a pipe while its queue is full
+  if (was_full) {
+    signal_event(reader_event[1]);
+  }
+
+  buffer.commit(length);
+  io_stats.bytes_read += length;
+  return length;
+}
+
 void GDB::read_until_prompt(std::ostream & output_buffer, std::ostream & error_buffer, bool trim_prompt) {
-  // Do non-blocking reads
+  // Repeated queries have nothing to read
+  if (write_cached_reply(output_buffer)) {
+    print_io_stats();
+    return;
+  }
+
+  // MI replies are delimited by records rather than by the prompt alone
+  if (interpreter == GDB_INTERPRETER_MI) {
+    read_mi_reply(pending_token, output_buffer, error_buffer, nullptr, 1, GDB_WAIT_STOP);
+    pending_token = -1;
+    finish_capture();
+    print_io_stats();
+    return;
+  }
+
+  // Everything that follows is a new reply
+  prompt_matcher.reset();
+
   bool hit_prompt = false;
+  bool candidate = false; // Set while the output ends with an unconfirmed prompt
   while (is_alive() && !hit_prompt) {
-    // Read process's error stream and append to error string
-    while (bufsz = process.err().readsome(buf, sizeof(buf))) {
-      std::string error(buf, bufsz);
-      error_buffer << error << std::flush;
+    // Wait for either stream to become readable; the timeout only bounds how
+    // long it takes to notice that GDB died without closing its pipes.
+    // A candidate prompt only has to be checked for trailing output.
+    int timeout = !candidate ? GG_POLL_TIMEOUT_MS : 
+      prompt_matcher.anchored() ? 0 : GG_PROMPT_SETTLE_MS;
+    bool output_ready, error_ready;
+    if (!wait_readable(output_ready, error_ready, timeout)) {
+      break;
+    }
+
+    // Nothing followed the candidate, so GDB is waiting for input
+    if (candidate && !output_ready) {
+      hit_prompt = true;
+    }
+
+    // Hand the process's error straight from the buffer to the error stream
+    if (error_ready && read_pipe(error_queue, error_data)) {
+      error_buffer.write(error_data.pending(), error_data.pending_size()) << std::flush;
+      error_data.consume(error_data.pending_size());
+      capture_failed = true;
     }
 
-    // Read process's output stream and append to output string 
-    std::string last_output; // Intermediate buffer used to hold last line of output
-    while (bufsz = process.out().readsome(buf, sizeof(buf))) {
-      std::string output(buf, bufsz);
+    // Only the newly read bytes are fed to the matcher; the held back
+    // prompt characters are still in front of them in the buffer
+    if (!hit_prompt && output_ready) {
+      size_t previous_length = output_data.pending_size();
+      if (!read_pipe(output_queue, output_data)) {
+        continue;
+      }
+      const char * output = output_data.pending();
+      size_t output_length = output_data.pending_size();
+      candidate = prompt_matcher.feed(output + previous_length, 
+          output_length - previous_length);
+
+      // Flush everything except the prompt characters, so output shows up
+      // immediately even if GDB goes quiet afterwards
+      size_t flushed_length = output_length - prompt_matcher.held();
+      output_buffer.write(output, flushed_length) << std::flush;
+      if (capturing_reply) {
+        captured_reply.append(output, flushed_length);
+      }
+      output_data.consume(flushed_length);
+    }
+  }
 
-      // Signal a break if output ends with the prompt
-      std::string combined_output = last_output + output; // Prompt can be split between two lines 
-      if (string_ends_with(combined_output, GDB_PROMPT)) {
-        hit_prompt = true;
+  // The held characters are either the confirmed prompt or, if GDB went 
+  // away, plain output that never turned into one
+  if (output_data.pending_size()) {
+    if (!hit_prompt || !trim_prompt) {
+      output_buffer.write(output_data.pending(), output_data.pending_size()) << std::flush;
+    }
+    output_data.consume(output_data.pending_size());
+  }
 
-        // Trim the prompt from the output if specified
-        if (trim_prompt) {
-          combined_output.erase(combined_output.size() - strlen(GDB_PROMPT), combined_output.size());
-        }
+  // A reply cut short by GDB going away isn't worth keeping
+  capture_failed = capture_failed || !hit_prompt;
+  finish_capture();
+  print_io_stats();
+}
 
-        // Next output to print should be the combined output (prevents double printing)
-        last_output = combined_output;
+void GDB::read_available(std::ostream & output_buffer, std::ostream & error_buffer) {
+  if (interpreter == GDB_INTERPRETER_MI) {
+    read_mi_reply(-1, output_buffer, error_buffer, nullptr, 0, GDB_WAIT_NONE);
+    return;
+  }
+
+  // The CLI has no records to tell apart, so everything is shown as is
+  bool output_ready, error_ready;
+  while (wait_readable(output_ready, error_ready, 0) && (output_ready || error_ready)) {
+    if (error_ready && read_pipe(error_queue, error_data)) {
+      error_buffer.write(error_data.pending(), error_data.pending_size()) << std::flush;
+      error_data.consume(error_data.pending_size());
+    }
+    if (output_ready && read_pipe(output_queue, output_data)) {
+      output_buffer.write(output_data.pending(), output_data.pending_size()) << std::flush;
+      output_data.consume(output_data.pending_size());
+    }
+  }
+}
+
+// Gets the token of a result record (e.g. 12 for "12^done"), or -1 if the
+// line isn't one.
+static long mi_result_token(const char * line, size_t length) {
+  long token = 0;
+  size_t i = 0;
+  for (; i < length && line[i] >= '0' && line[i] <= '9'; i++) {
+    token = token * 10 + line[i] - '0';
+  }
+  return i && i < length && line[i] == MI_RESULT_PREFIX ? token : -1;
+}
+
+void GDB::read_mi_reply(long token, std::ostream & output_buffer, std::ostream & error_buffer,
+    GDBQuery * queries, size_t count, GDBWait wait)
+{
+  long arena_allocations = mi_arena.get_allocations() + mi_scratch.get_allocations();
+
+  // Without a command (e.g. at startup) the first prompt ends the reply.
+  // Each command of a batch is answered in order with a result record and
+  // a prompt; the prompt after the last result ends the reply.
+  size_t results = token < 0 ? count : 0;
+  bool waiting_for_stop = false;
+  bool hit_prompt = false;
+  size_t scanned_length = 0; // Pending bytes already known to hold no newline
+  while (!hit_prompt) {
+    // Handle every complete line in the buffer before reading more; the 
+    // search resumes where it stopped, so a huge record is scanned once
+    char * output = output_data.pending();
+    size_t output_length = output_data.pending_size();
+    char * newline = (char *) memchr(output + scanned_length, '\n', 
+        output_length - scanned_length);
+    if (newline) {
+      size_t line_length = newline - output;
+      size_t record_length = line_length && output[line_length - 1] == '\r' ? 
+        line_length - 1 : line_length;
+      scanned_length = 0;
+
+      // Records are parsed where they were read. Only the result records
+      // of queries outlive the read buffer, so they alone are copied into
+      // the arena; everything else goes to scratch space reused per record
+      long line_token = mi_result_token(output, record_length);
+      bool keep = queries && line_token >= token && line_token < token + (long) count;
+      if (keep && queries[line_token - token].cacheable) {
+        queries[line_token - token].record.assign(output, record_length);
+      }
+      char * line = keep ? mi_arena.copy(output, record_length) : output;
+      mi_scratch.reset();
+
+      // Anything that isn't MI was printed by the inferior
+      MIRecord record;
+      if (!mi_parse_record(line, record_length, keep ? mi_arena : mi_scratch, record)) {
+        output_buffer.write(output, line_length) << std::endl;
+        output_data.consume(line_length + 1);
+        continue;
       }
-      else {
-        // Flush last output
-        output_buffer << last_output << std::flush;
 
-        // Set next output to print to be the current output
-        last_output = output;
+      switch (record.type) {
+        case MI_RECORD_PROMPT:
+          hit_prompt = wait != GDB_WAIT_NONE && results == count && !waiting_for_stop;
+          break;
+        case MI_RECORD_CONSOLE:
+        case MI_RECORD_TARGET:
+          // Console output comes before the result of the query printing it
+          if (queries && results < count) {
+            queries[results].output.append(record.text.data, record.text.size);
+          }
+          else {
+            output_buffer.write(record.text.data, record.text.size) << std::flush;
+            if (capturing_reply) {
+              captured_reply.append(record.text.data, record.text.size);
+            }
+          }
+          break;
+        case MI_RECORD_LOG:
+          error_buffer.write(record.text.data, record.text.size) << std::flush;
+          break;
+        case MI_RECORD_RESULT:
+          // Ignore late replies to commands we've given up on
+          if (record.token < token || record.token >= token + (long) count) {
+            break;
+          }
+          results++;
+          if (record.record_class == MI_CLASS_ERROR) {
+            MIString message = record.results.get("msg");
+            error_buffer.write(message.data, message.size) << std::endl;
+            capture_failed = true;
+          }
+
+          // A resumed inferior is followed by a second prompt once it stops
+          waiting_for_stop = wait == GDB_WAIT_STOP && record.record_class == MI_CLASS_RUNNING;
+          if (queries) {
+            GDBQuery & query = queries[record.token - token];
+            query.result = record;
+            query.succeeded = record.record_class != MI_CLASS_ERROR;
+          }
+          break;
+        case MI_RECORD_EXEC:
+          if (record.record_class == MI_CLASS_STOPPED) {
+            waiting_for_stop = false;
+          }
+          track_state(record);
+          break;
+        case MI_RECORD_NOTIFY:
+          track_state(record);
+          break;
+        default:
+          break;
       }
+
+      // Views into the read buffer stay valid until the next read
+      output_data.consume(line_length + 1);
+      continue;
+    }
+    scanned_length = output_length;
+
+    if (!is_alive()) {
+      break;
+    }
+
+    // A partial line that doesn't start like a record is the inferior 
+    // prompting for input without a newline; show it once GDB goes quiet
+    bool partial_output = output_length && output[0] &&
+      !strchr("0123456789^*+=~@&(", output[0]);
+    int timeout = wait == GDB_WAIT_NONE ? 0 :
+      partial_output ? GG_PROMPT_SETTLE_MS : GG_POLL_TIMEOUT_MS;
+    bool output_ready, error_ready;
+    if (!wait_readable(output_ready, error_ready, timeout)) {
+      break;
+    }
+    if (partial_output && !output_ready && !error_ready) {
+      output_buffer.write(output, output_length) << std::flush;
+      output_data.consume(output_length);
+      scanned_length = 0;
+      continue;
     }
 
-    // Flush last output that wasn't emptied by the loop
-    output_buffer << last_output << std::flush;
+    // Hand the process's error straight from the buffer to the error stream
+    if (error_ready && read_pipe(error_queue, error_data)) {
+      error_buffer.write(error_data.pending(), error_data.pending_size()) << std::flush;
+      error_data.consume(error_data.pending_size());
+    }
+
+    if (output_ready) {
+      read_pipe(output_queue, output_data);
+    }
+    else if (wait == GDB_WAIT_NONE && !error_ready) {
+      break;
+    }
+  }
+
+  io_stats.allocations += mi_arena.get_allocations() + mi_scratch.get_allocations() - 
+    arena_allocations;
+}
+
+void GDB::print_io_stats() {
+  if (report_io_stats && !io_stats_command.empty()) {
+    collect_io_stats();
+    std::cerr << "[gg] " << io_stats_command << ": " <<
+      io_stats.writes << " writes, " <<
+      io_stats.polls << " polls, " <<
+      io_stats.reads << " reads, " <<
+      io_stats.bytes_read << " bytes, " <<
+      io_stats.waits << " waits, " <<
+      io_stats.pops << " pops, " <<
+      io_stats.allocations << " allocations" << std::endl;
+  }
+}
+
+void GDB::start_io_stats(const char * command) {
+  io_stats = GDBIOStats();
+  io_stats_command = command;
+  io_stats_polls_start = pipe_polls.load(std::memory_order_relaxed);
+  io_stats_reads_start = pipe_reads.load(std::memory_order_relaxed);
+}
+
+void GDB::collect_io_stats() {
+  // The reader thread counts on its own, so this takes what it has counted
+  // since the command started
+  io_stats.polls = pipe_polls.load(std::memory_order_relaxed) - io_stats_polls_start;
+  io_stats.reads = pipe_reads.load(std::memory_order_relaxed) - io_stats_reads_start;
+}
+
+bool GDB::is_running_program() {
+  // MI tells us whenever an inferior starts or exits
+  if (interpreter == GDB_INTERPRETER_MI) {
+    return live_inferiors > 0;
+  }
+
+  if (running_reset_flag) {
+    // Collect program status output
+    std::string program_status = execute_and_read(GDB_INFO_PROGRAM);
+
+    // Output with "not being run" only appears when GDB is not running anything
+    running_program = !string_contains(program_status, "not being run");
+    set_inferior_pid(running_program ? find_program_pid(program_status) : 0);
+
+    // Set flag to false, execute will reset it
+    running_reset_flag = false;
+  }
+
+  return running_program; 
+}
+
+void GDB::track_state(const MIRecord & record) {
+  // Breakpoints are drawn in the source, so it is shown again
+  if (track_breakpoint(record)) {
+    state_changed = true;
+    return;
+  }
+
+  // Whatever the inferior does may change what queries return
+  if (record.record_class == MI_CLASS_RUNNING || 
+      record.record_class == MI_CLASS_MEMORY_CHANGED) {
+    // Code only changes if it is written to
+    if (record.record_class == MI_CLASS_MEMORY_CHANGED) {
+      disassemblies.clear();
+    }
+    invalidate_cache();
+    return;
+  }
+
+  if (record.record_class == MI_CLASS_THREAD_GROUP_STARTED) {
+    // A new run may load the program or its libraries somewhere else
+    disassemblies.clear();
+    register_table.clear();
+    live_inferiors++;
+
+    // With several inferiors the stack may belong to any of them
+    inferior_group = record.results.get("id").str();
+    set_inferior_pid(live_inferiors == 1 ? record.results.get("pid").to_long() : 0);
+  }
+  else if (record.record_class == MI_CLASS_THREAD_GROUP_EXITED) {
+    live_inferiors = std::max(live_inferiors - 1, (long) 0);
+    if (record.results.get("id") == inferior_group.c_str()) {
+      set_inferior_pid(0);
+    }
+  }
+  else if (record.record_class != MI_CLASS_STOPPED && 
+      record.record_class != MI_CLASS_THREAD_SELECTED) {
+    return;
+  }
+
+  // Stops and frame changes carry the frame; exits don't have one
+  const MIValue * frame = record.results.find("frame");
+  stopped_line_number = frame ? frame->get("line").to_long() : 0;
+  stopped_source_path = frame ? frame->get("fullname").str() : std::string();
+  stopped_address = frame ? frame->get("addr").to_ulong(0) : 0;
+  state_changed = true;
+  invalidate_cache();
+}
+
+bool GDB::track_breakpoint(const MIRecord & record) {
+  if (record.record_class == MI_CLASS_BREAKPOINT_DELETED) {
+    breakpoints.erase(record.results.get("id").str());
+    return true;
+  }
+  if (record.record_class != MI_CLASS_BREAKPOINT_CREATED && 
+      record.record_class != MI_CLASS_BREAKPOINT_MODIFIED) {
+    return false;
+  }
+  const MIValue * breakpoint = record.results.find("bkpt");
+  if (!breakpoint) {
+    return true;
+  }
+  std::vector<GDBBreakpointLocation> & locations = breakpoints[breakpoint->get("number").str()];
+  locations.clear();
+  if (breakpoint->get("enabled") != "y") {
+    return true;
   }
-}
 
-bool GDB::is_alive() {
-  bool exited = 
-    process.out().rdbuf()->exited() || // Check process output buffer
-    process.err().rdbuf()->exited();   // Check process error buffer
-  return !exited;
+  // A breakpoint set in several places lists each, and each may be disabled
+  const MIValue * listed = breakpoint->find("locations");
+  for (const MIValue * location = listed ? listed->first : breakpoint; location; 
+      location = listed ? location->next : nullptr) {
+    if (location->get("enabled") == "y" && !location->get("fullname").empty()) {
+      GDBBreakpointLocation found;
+      found.path = location->get("fullname").str();
+      found.line = location->get("line").to_long();
+      locations.push_back(found);
+    }
+  }
+  return true;
 }
 
-bool GDB::is_running_program() {
-  if (running_reset_flag) {
-    // Collect program status output
-    std::string program_status = execute_and_read(GDB_INFO_PROGRAM);
-
-    // Output with "not being run" only appears when GDB is not running anything
-    running_program = !string_contains(program_status, "not being run");
+bool GDB::needs_refresh() {
+  if (interpreter == GDB_INTERPRETER_MI) {
+    bool changed = state_changed;
+    state_changed = false;
+    if (changed) {
+      saved_line_number = is_running_program() ? stopped_line_number : 0;
+    }
+    return changed;
+  }
 
-    // Set flag to false, execute will reset it
-    running_reset_flag = false;
+  // Without notifications, only ask after commands, and only see a change
+  // if the line did
+  if (!running_reset_flag) {
+    return false;
   }
+  long line_number = is_running_program() ? get_source_line_number() : 0;
+  bool changed = line_number != saved_line_number;
+  saved_line_number = line_number;
+  return changed;
+}
 
-  return running_program; 
+std::unique_ptr<GDBSourcePosition> GDB::get_source_position() {
+  std::string path = is_running_program() ? get_source_path() : std::string();
+  std::shared_ptr<GDBSourceFile> file = open_source_file(path, saved_line_number);
+  if (!file) {
+    return nullptr;
+  }
+  std::unique_ptr<GDBSourcePosition> position(new GDBSourcePosition());
+  position->path = path;
+  position->file = file;
+  position->line = saved_line_number;
+  for (std::map<std::string, std::vector<GDBBreakpointLocation>>::const_iterator breakpoint = 
+      breakpoints.begin(); breakpoint != breakpoints.end(); breakpoint++) {
+    for (size_t i = 0; i < breakpoint->second.size(); i++) {
+      if (breakpoint->second[i].path == path) {
+        position->breakpoint_lines.push_back(breakpoint->second[i].line);
+      }
+    }
+  }
+  std::sort(position->breakpoint_lines.begin(), position->breakpoint_lines.end());
+  return position;
 }
 
 std::string GDB::get_source_code() {
@@ -176,25 +1476,54 @@ std::string GDB::get_source_code() {
     return std::string(GDB_NO_SOURCE_CODE);
   }
 
-  // Save the current list size and list line number
-  long list_size = get_source_list_size();
+  // GDB lists an explicit range, which leaves its list size alone; 
+  // selecting the frame again puts "list" back around the current line
+  long first_line = std::max((long) 1, saved_line_number - GG_FRAME_LINES / 2);
+  std::string source = execute_and_read((std::string(GDB_LIST " ") + std::to_string(first_line) + "," +
+    std::to_string(first_line + GG_FRAME_LINES - 1)).c_str());
+  execute_and_read(GDB_FRAME);
+  return source; 
+}
+
+std::string GDB::get_source_path() {
+  if (interpreter == GDB_INTERPRETER_MI) {
+    return is_running_program() ? stopped_source_path : std::string();
+  }
 
-  // Get source code lines
-  execute_and_read(GDB_SET_LIST_SIZE, GG_FRAME_LINES);
-  std::string source = execute_and_read(GDB_LIST, saved_line_number); 
+  // Only asked once per stop, since the reply is cached until the inferior moves
+  std::string output = execute_and_read(GDB_INFO_SOURCE);
+  size_t located = output.find(GDB_SOURCE_LOCATED);
+  if (located == std::string::npos) {
+    return std::string();
+  }
+  located += strlen(GDB_SOURCE_LOCATED);
+  return output.substr(located, output.find('\n', located) - located);
+}
 
-  // Trick GDB's list range by printing the line before what we printed
-  // NOT A PERFECT SOLUTION: if original_line_number == 1, then the first
-  // line will never be printed by a subsequent list call
-  long original_line_number = std::max(
-      (long) 1, saved_line_number - list_size / 2 - 1);
-  execute_and_read(GDB_SET_LIST_SIZE, 1);
-  execute_and_read(GDB_LIST, original_line_number);
+std::shared_ptr<GDBSourceFile> GDB::open_source_file(const std::string & path, long line_number) {
+  if (path.empty() || line_number < 1) {
+    return nullptr;
+  }
 
-  // Restore old list size
-  execute_and_read(GDB_SET_LIST_SIZE, list_size);
+  // Files stay open until they change on disk; the GUI keeps showing 
+  // the old contents until it is given the new ones
+  std::shared_ptr<GDBSourceFile> & file = source_files[path];
+  if (file && file->is_stale(path)) {
+    file.reset();
+  }
+  if (!file) {
+    file.reset(new GDBSourceFile());
+    if (!file->open(path)) {
+      source_files.erase(path);
+      return nullptr;
+    }
+  }
 
-  return source; 
+  // A line past the end means the file isn't what the program was built from
+  if (line_number > file->get_line_count()) {
+    return nullptr;
+  }
+  return file;
 }
 
 std::string GDB::get_local_variables() {
@@ -203,6 +1532,10 @@ std::string GDB::get_local_variables() {
     return std::string(GDB_NO_LOCALS);
   }
 
+  if (interpreter == GDB_INTERPRETER_MI) {
+    return format_variables(get_variables(false), GDB_MI_NO_LOCALS);
+  }
+
   return execute_and_read(GDB_INFO_LOCALS);
 }
 
@@ -212,6 +1545,10 @@ std::string GDB::get_formal_parameters() {
     return std::string(GDB_NO_PARAMS);
   }
 
+  if (interpreter == GDB_INTERPRETER_MI) {
+    return format_variables(get_variables(true), GDB_MI_NO_ARGUMENTS);
+  }
+
   return execute_and_read(GDB_INFO_ARGUMENTS);
 }
 
@@ -221,6 +1558,13 @@ std::string GDB::get_variable_value(const char * variable) {
     return std::string(GDB_NO_VARIABLE);
   }
 
+  // MI reports the value alone, or the reason there isn't one
+  if (interpreter == GDB_INTERPRETER_MI) {
+    MIRecord result;
+    bool evaluated = execute_mi(std::string(GDB_MI_EVALUATE " ") + mi_quote(variable), result);
+    return result.results.get(evaluated ? "value" : "msg").str();
+  }
+
   // Get raw value of variable (e.g. $1 = ...)
   std::string value = execute_and_read(GDB_PRINT, variable);
 
@@ -234,12 +1578,25 @@ std::string GDB::get_variable_value(const char * variable) {
   return value.substr(split_index + 2, value.size());
 }
 
-StackFrame * GDB::get_stack_frame() {
+std::unique_ptr<StackFrame> GDB::get_stack_frame() {
   // Program is not running
   if (!is_running_program()) {
     return nullptr; 
   }
 
+  if (interpreter == GDB_INTERPRETER_MI) {
+    // Locate the frame, then fetch it as raw bytes
+    unsigned long stack_pointer, frame_pointer;
+    MIMemory memory;
+    if (!evaluate_address(GDB_STACK_POINTER, stack_pointer) ||
+        !evaluate_address(GDB_FRAME_POINTER, frame_pointer) ||
+        frame_pointer <= stack_pointer ||
+        !read_memory(stack_pointer, frame_pointer - stack_pointer + ADDITIONAL_STACK_SPACE, memory)) {
+      return nullptr;
+    }
+    return make_stack_frame(stack_pointer, frame_pointer, memory);
+  }
+
   // Get raw output from GDB as to the locations of the stack and frame pointers
   std::string stack_pointer_output = 
     execute_and_read(GDB_PRINT, GDB_STACK_POINTER);
@@ -267,31 +1624,12 @@ StackFrame * GDB::get_stack_frame() {
     return nullptr;
   }
 
-  // Set the stack frame struct parameters 
-  StackFrame * stack_frame = (StackFrame *) malloc(sizeof(StackFrame)); 
-  stack_frame->stack_pointer = stack_pointer;
-  stack_frame->frame_pointer = frame_pointer;
-  stack_frame->memory_length = stack_frame_length + ADDITIONAL_STACK_SPACE;
-  stack_frame->memory = (long *) malloc(stack_frame->memory_length * sizeof(long));
-
-  // Create and execute the GDB memory examine command for the stack
-  char examine[100];
-  snprintf(examine, 100, "%s/%ld%s%s", GDB_EXAMINE, stack_frame->memory_length, GDB_MEMORY_SIZE_BYTE, GDB_MEMORY_TYPE_LONG);
-  std::string stack_frame_output = execute_and_read(examine, GDB_STACK_POINTER);
-
-  // Iterate through lines, then tab-delimited tokens
-  long index = 0;
-  for(std::string line : split(stack_frame_output, '\n')) {
-    for (std::string token : split(line, '\t')) {
-      // Ignore tokens that are addresses, since we know the beginning and ending addresses
-      if (!string_ends_with(token, ":")) {
-        // Fill the stack frame 
-        stack_frame->memory[index++] = std::stol(token, nullptr, 16);
-      }
-    }
+  // Fetch the frame as raw bytes rather than GDB's text for every byte
+  MIMemory memory;
+  if (!read_memory(stack_pointer, stack_frame_length + ADDITIONAL_STACK_SPACE, memory)) {
+    return nullptr;
   }
-
-  return stack_frame;
+  return make_stack_frame(stack_pointer, frame_pointer, memory);
 }
 
 std::string GDB::get_assembly_code() {
@@ -300,8 +1638,32 @@ std::string GDB::get_assembly_code() {
     return std::string(GDB_NO_ASSEMBLY_CODE);
   }
 
-  // Get full assembly dump
-  std::string assembly_dump = execute_and_read(GDB_DISASSEMBLE);
+  // Instructions are disassembled a bounded window at a time, so a huge 
+  // function costs no more than a small one and code outside of any 
+  // function shows too; stepping inside a window costs nothing
+  if (interpreter == GDB_INTERPRETER_MI) {
+    unsigned long program_counter;
+    if (!evaluate_address(GDB_PROGRAM_COUNTER, program_counter)) {
+      return std::string(GDB_NO_ASSEMBLY_CODE);
+    }
+    const GDBDisassembly * run = find_disassembly(program_counter);
+    if (!run || !has_window(*run, find_instruction(run->instructions, program_counter))) {
+      run = disassemble_around(program_counter);
+    }
+    return run ? show_assembly(*run, program_counter) : std::string(GDB_NO_ASSEMBLY_CODE);
+  }
+
+  // Get a window of the assembly around the program counter; if decoding
+  // backwards never lined up with it, start at the program counter instead
+  std::string window = std::string(GDB_DISASSEMBLE " " GDB_PROGRAM_COUNTER "-") + 
+    std::to_string(GG_DISASSEMBLY_BEHIND) + "," GDB_PROGRAM_COUNTER "+" + 
+    std::to_string(GG_DISASSEMBLY_AHEAD);
+  std::string assembly_dump = execute_and_read(window.c_str());
+  if (!string_contains(assembly_dump, "=>")) {
+    window = std::string(GDB_DISASSEMBLE " " GDB_PROGRAM_COUNTER ",+") + 
+      std::to_string(GG_DISASSEMBLY_AHEAD);
+    assembly_dump = execute_and_read(window.c_str());
+  }
   std::stringstream assembly_stream(assembly_dump);
 
   // Vector holding split lines 
@@ -325,21 +1687,7 @@ std::string GDB::get_assembly_code() {
     current_line++;
   }
 
-  // Concise assembly string that we want to return
-  std::string assembly;
-  // Relevant starting line in the assembly dump 
-  int starting_line = std::max(1, executing_line - GG_FRAME_LINES / 2);
-  // Relevant ending line in the assembly dump
-  int ending_line = starting_line + GG_FRAME_LINES;
-
-  // Iterate through all relevant lines and append each to output 
-  for (int i = starting_line; i < ending_line; i++) {
-    if (i < assembly_lines.size()) {
-      assembly.append(assembly_lines[i]).append("\n");
-    }
-  }
-
-  return assembly;
+  return frame_window(assembly_lines, executing_line);
 }
 
 std::string GDB::get_registers() {
@@ -348,16 +1696,19 @@ std::string GDB::get_registers() {
     return std::string(GDB_NO_REGISTERS);
   }
 
-  return execute_and_read(GDB_INFO_REGISTERS);
-}
+  if (interpreter == GDB_INTERPRETER_MI) {
+    return format_registers(get_register_table());
+  }
 
-long GDB::get_source_list_size() {
-  std::string output = execute_and_read(GDB_GET_LIST_SIZE);
-  std::string last_word = output.substr(output.find_last_of(' '), output.size() - 1);
-  return std::stol(last_word); 
+  return execute_and_read(GDB_INFO_REGISTERS);
 }
 
 long GDB::get_source_line_number() {
+  // Frames without debugging information have no line
+  if (interpreter == GDB_INTERPRETER_MI) {
+    return is_running_program() ? stopped_line_number : 0;
+  }
+
   std::string output = execute_and_read(GDB_WHERE);
 
   // Edge case: program can still be running but 
@@ -370,3 +1721,623 @@ long GDB::get_source_line_number() {
   std::string target_word = target_line.substr(0, target_line.find('\n'));
   return std::stol(target_word);
 }
+
+bool GDB::evaluate_address(const char * expression, unsigned long & address) {
+  // Expressions that may change the inferior are never answered from the
+  // cache, and what was read before them is stale once they ran
+  bool changes_inferior = command_has_side_effects(expression);
+  if (changes_inferior) {
+    invalidate_cache();
+  }
+  MIRecord result;
+  bool evaluated = execute_mi(evaluate_address_command(expression), result);
+  if (changes_inferior) {
+    invalidate_cache();
+  }
+  if (!evaluated) {
+    return false;
+  }
+
+  address = result.results.get("value").to_ulong(0);
+  return true;
+}
+
+std::vector<MIVariable> GDB::get_variables(bool arguments) {
+  std::vector<MIVariable> variables;
+  MIRecord result;
+
+  if (arguments) {
+    // Arguments are listed per frame; only the innermost one was asked for
+    if (execute_mi(GDB_MI_ARGUMENTS, result)) {
+      const MIValue * frames = result.results.find("stack-args");
+      const MIValue * args = frames && frames->first ?
+        frames->first->find("args") : nullptr;
+      if (args) {
+        mi_variables(*args, true, variables);
+      }
+    }
+  }
+  else if (execute_mi(GDB_MI_LOCALS, result)) {
+    const MIValue * locals = result.results.find("locals");
+    if (locals) {
+      mi_variables(*locals, false, variables);
+    }
+  }
+
+  return variables;
+}
+
+const std::vector<GDBRegister> & GDB::get_register_table() {
+  learn_register_names();
+
+  MIRecord result;
+  execute_mi(GDB_MI_CHANGED_REGISTERS, result);
+  std::vector<long> numbers = get_changed_registers(result);
+  if (!numbers.empty()) {
+    execute_mi(get_register_values_command(GDB_MI_FORMAT_RAW, numbers), result);
+    set_register_values(result, true);
+    execute_mi(get_register_values_command(GDB_MI_FORMAT_NATURAL, numbers), result);
+    set_register_values(result, false);
+  }
+  return register_table;
+}
+
+void GDB::set_register_group_expanded(GDBRegisterGroup group, bool expanded) {
+  group_expanded[group] = expanded;
+}
+
+std::string GDB::get_register_group(GDBRegisterGroup group) {
+  // Program is not running
+  if (interpreter != GDB_INTERPRETER_MI || !is_running_program()) {
+    return std::string(GDB_NO_REGISTERS);
+  }
+
+  learn_register_group(group);
+  std::vector<std::string> commands;
+  add_register_group_queries(group, commands);
+  std::vector<GDBQuery> queries(commands.size());
+  for (size_t i = 0; i < commands.size(); i++) {
+    queries[i].command = commands[i];
+  }
+  execute_batch(queries);
+  return format_register_group(group, queries.data());
+}
+
+void GDB::learn_register_names() {
+  // Register names never change, so they are only fetched once
+  if (register_names.empty()) {
+    MIRecord names;
+    execute_mi(GDB_MI_REGISTER_NAMES, names);
+    set_register_names(names, execute_and_read(GDB_INFO_REGISTERS));
+  }
+}
+
+void GDB::learn_register_group(GDBRegisterGroup group) {
+  // MI has no notion of register groups either, so they are learned from
+  // "info registers" too; the listing can be huge but is only read once
+  if (!group_known[group]) {
+    learn_register_names();
+    group_registers[group] = find_register_numbers(execute_and_read(
+          (std::string(GDB_INFO_REGISTERS " ") + register_group_names[group]).c_str()));
+    group_known[group] = true;
+  }
+}
+
+void GDB::add_register_group_queries(GDBRegisterGroup group, std::vector<std::string> & commands) {
+  // Vector registers are decoded from their bits rather than fetched in
+  // GDB's natural format, which spells out every view of them
+  if (group_registers[group].empty()) {
+    return;
+  }
+  commands.push_back(get_register_values_command(GDB_MI_FORMAT_BITS, group_registers[group]));
+  if (group != GDB_GROUP_VECTOR) {
+    commands.push_back(get_register_values_command(GDB_MI_FORMAT_NATURAL, group_registers[group]));
+  }
+}
+
+std::string GDB::format_register_group(GDBRegisterGroup group, const GDBQuery * queries) {
+  std::vector<GDBRegister> registers(group_registers[group].size());
+  for (size_t row = 0; row < registers.size(); row++) {
+    registers[row].number = group_registers[group][row];
+    registers[row].name = register_names[registers[row].number];
+  }
+  if (registers.empty()) {
+    return std::string(GDB_NO_REGISTERS);
+  }
+
+  // Values come back in the order they were asked for
+  const MIValue * bits = queries[0].result.results.find("register-values");
+  const MIValue * natural = group != GDB_GROUP_VECTOR ? 
+    queries[1].result.results.find("register-values") : nullptr;
+  const MIValue * value = bits ? bits->first : nullptr;
+  for (size_t row = 0; value && row < registers.size(); row++, value = value->next) {
+    registers[row].raw = value->get("value").str();
+  }
+  value = natural ? natural->first : nullptr;
+  for (size_t row = 0; value && row < registers.size(); row++, value = value->next) {
+    registers[row].natural = value->get("value").str();
+  }
+
+  // Registers wider than 64 bits are vectors
+  std::string text;
+  for (size_t row = 0; row < registers.size(); row++) {
+    text.append(format_register(registers[row])).append("\n");
+    if (group == GDB_GROUP_VECTOR && registers[row].raw.size() > 2 + 16) {
+      text.append(format_lanes(registers[row].raw));
+    }
+  }
+  return text;
+}
+
+void GDB::set_register_names(const MIRecord & names, const std::string & general_output) {
+  const MIValue * list = names.results.find("register-names");
+  for (const MIValue * name = list ? list->first : nullptr; name; name = name->next) {
+    register_names.push_back(name->string.str());
+  }
+
+  // MI has no notion of register groups, so borrow the names of the
+  // registers "info registers" shows by default
+  general_registers = find_register_numbers(general_output);
+}
+
+std::vector<long> GDB::find_register_numbers(const std::string & listing) {
+  std::vector<long> numbers;
+  std::vector<std::string> lines = split(listing, '\n');
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::string name = lines[i].substr(0, lines[i].find_first_of(" \t"));
+    for (size_t number = 0; number < register_names.size(); number++) {
+      if (!name.empty() && register_names[number] == name) {
+        numbers.push_back(number);
+      }
+    }
+  }
+  return numbers;
+}
+
+std::vector<long> GDB::get_changed_registers(const MIRecord & changed) {
+  for (size_t row = 0; row < register_table.size(); row++) {
+    register_table[row].changed = false;
+  }
+
+  // A new table is filled in full without flagging anything
+  if (register_table.size() != general_registers.size()) {
+    register_table.resize(general_registers.size());
+    for (size_t row = 0; row < register_table.size(); row++) {
+      register_table[row].number = general_registers[row];
+      register_table[row].name = register_names[general_registers[row]];
+      register_table[row].changed = false;
+    }
+    return general_registers;
+  }
+
+  // GDB compares against what it saw the last time it was asked
+  std::vector<long> numbers;
+  const MIValue * list = changed.results.find("changed-registers");
+  for (const MIValue * number = list ? list->first : nullptr; number; number = number->next) {
+    std::vector<long>::const_iterator row = std::find(general_registers.begin(), 
+        general_registers.end(), number->string.to_long());
+    if (row != general_registers.end()) {
+      register_table[row - general_registers.begin()].changed = true;
+      numbers.push_back(*row);
+    }
+  }
+  return numbers;
+}
+
+void GDB::set_register_values(const MIRecord & values, bool raw) {
+  const MIValue * list = values.results.find("register-values");
+  for (const MIValue * value = list ? list->first : nullptr; value; value = value->next) {
+    std::vector<long>::const_iterator row = std::find(general_registers.begin(), 
+        general_registers.end(), value->get("number").to_long());
+    if (row != general_registers.end()) {
+      GDBRegister & reg = register_table[row - general_registers.begin()];
+      (raw ? reg.raw : reg.natural) = value->get("value").str();
+    }
+  }
+}
+
+std::string GDB::get_register_values_command(char format, const std::vector<long> & numbers) {
+  std::string command(GDB_MI_REGISTER_VALUES " ");
+  command.push_back(format);
+  for (size_t i = 0; i < numbers.size(); i++) {
+    command.append(" ").append(std::to_string(numbers[i]));
+  }
+  return command;
+}
+
+void GDB::set_inferior_pid(long pid) {
+  if (pid != inferior_pid) {
+    inferior_pid = pid;
+    inferior_checked = false;
+    inferior_local = false;
+  }
+}
+
+bool GDB::read_inferior_memory(unsigned long address, long length, MIMemory & memory) {
+#ifdef __linux__
+  if (inferior_pid <= 0 || length <= 0) {
+    return false;
+  }
+
+  // GDB, our child, traces whatever it runs or attaches to on this 
+  // machine, while the process ids of remote targets mean nothing here
+  if (!inferior_checked) {
+    long tracer_pid = find_status_value(inferior_pid, "TracerPid:");
+    inferior_local = tracer_pid > 0 && find_status_value(tracer_pid, "PPid:") == getpid();
+    inferior_checked = true;
+  }
+  if (!inferior_local) {
+    return false;
+  }
+
+  memory.begin = address;
+  memory.contents.resize(length);
+  struct iovec local_range = { memory.contents.data(), (size_t) length };
+  struct iovec inferior_range = { (void *) address, (size_t) length };
+  ssize_t read_length = process_vm_readv(inferior_pid, &local_range, 1, &inferior_range, 1, 0);
+  if (read_length != length) {
+    // Kernels without the call may still let the memory be read as a file
+    std::string path = "/proc/" + std::to_string(inferior_pid) + "/mem";
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    read_length = fd < 0 ? -1 : pread(fd, memory.contents.data(), length, (off_t) address);
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  if (read_length != length) {
+    memory.contents.clear();
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool GDB::read_memory(unsigned long address, long length, MIMemory & memory) {
+  if (read_inferior_memory(address, length, memory)) {
+    return true;
+  }
+
+  std::string command = std::string(GDB_MI_READ_MEMORY " ") + 
+    std::to_string(address) + " " + std::to_string(length);
+
+  MIRecord result;
+  const MIValue * blocks = execute_mi(command, result) ?
+    result.results.find("memory") : nullptr;
+  return blocks && mi_memory(*blocks, memory);
+}
+
+const GDBDisassembly * GDB::find_disassembly(unsigned long address) const {
+  // The run starting at or right before the address, if it reaches it
+  std::map<unsigned long, GDBDisassembly>::const_iterator run = 
+    disassemblies.upper_bound(address);
+  if (run == disassemblies.begin()) {
+    return nullptr;
+  }
+  run--;
+  return find_instruction(run->second.instructions, address) >= 0 ? &run->second : nullptr;
+}
+
+const GDBDisassembly * GDB::add_disassembly(const MIValue & listing, bool guessed_start,
+    unsigned long required_address)
+{
+  std::vector<MIInstruction> instructions;
+  mi_instructions(listing, instructions);
+  long required = find_instruction(instructions, required_address);
+  if (required < 0) {
+    return nullptr;
+  }
+
+  // On x86 decoding from the middle of an instruction soon falls in step
+  // with the real ones, but what comes before that is garbage
+  if (guessed_start) {
+    instructions.erase(instructions.begin(), 
+        instructions.begin() + std::min(required, (long) GG_DISASSEMBLY_RESYNC));
+  }
+  return store_disassembly(instructions);
+}
+
+const GDBDisassembly * GDB::store_disassembly(std::vector<MIInstruction> & instructions) {
+  unsigned long first_address = instructions.front().address;
+  unsigned long last_address = instructions.back().address;
+
+  // Whatever the run overlaps may have been decoded out of step with it
+  std::map<unsigned long, GDBDisassembly>::iterator next = 
+    disassemblies.upper_bound(last_address);
+  while (next != disassemblies.begin()) {
+    std::map<unsigned long, GDBDisassembly>::iterator previous = std::prev(next);
+    if (previous->second.last_address < first_address) {
+      break;
+    }
+    next = disassemblies.erase(previous);
+  }
+
+  GDBDisassembly & run = disassemblies[first_address];
+  run.first_address = first_address;
+  run.last_address = last_address;
+  run.instructions.swap(instructions);
+  return &run;
+}
+
+const GDBDisassembly * GDB::disassemble_around(unsigned long program_counter) {
+  MIRecord result;
+  const MIValue * listing = execute_mi(disassemble_window_command(), result) ?
+    result.results.find("asm_insns") : nullptr;
+  const GDBDisassembly * run = listing ? 
+    add_disassembly(*listing, true, program_counter) : nullptr;
+
+  // Decoding forwards from the program counter is always in step
+  if (!run) {
+    listing = execute_mi(disassemble_command(std::to_string(program_counter), 
+          std::to_string(program_counter + GG_DISASSEMBLY_AHEAD)), result) ?
+      result.results.find("asm_insns") : nullptr;
+    run = listing ? add_disassembly(*listing, false, program_counter) : nullptr;
+  }
+  return run;
+}
+
+const GDBDisassembly * GDB::extend_disassembly(const GDBDisassembly & run, bool backward) {
+  // Going backwards, the listing has to run into the first instruction
+  // known to be real to count; going forwards it starts on the last one
+  unsigned long begin = backward ? 
+    run.first_address - std::min(run.first_address, (unsigned long) GG_DISASSEMBLY_BEHIND) : 
+    run.last_address;
+  unsigned long end = backward ? run.first_address + 1 : run.last_address + GG_DISASSEMBLY_AHEAD;
+
+  MIRecord result;
+  const MIValue * listing = execute_mi(disassemble_command(std::to_string(begin), 
+        std::to_string(end)), result) ? result.results.find("asm_insns") : nullptr;
+  std::vector<MIInstruction> instructions;
+  if (listing) {
+    mi_instructions(*listing, instructions);
+  }
+  long joint = find_instruction(instructions, backward ? run.first_address : run.last_address);
+  if (joint < 0 || (backward ? joint <= GG_DISASSEMBLY_RESYNC : 
+        joint + 1 == (long) instructions.size())) {
+    return &run;
+  }
+
+  if (backward) {
+    instructions.erase(instructions.begin() + joint, instructions.end());
+    instructions.erase(instructions.begin(), instructions.begin() + GG_DISASSEMBLY_RESYNC);
+    instructions.insert(instructions.end(), run.instructions.begin(), run.instructions.end());
+  }
+  else {
+    instructions.erase(instructions.begin(), instructions.begin() + joint + 1);
+    instructions.insert(instructions.begin(), run.instructions.begin(), run.instructions.end());
+  }
+  return store_disassembly(instructions);
+}
+
+std::string GDB::show_assembly(const GDBDisassembly & run, unsigned long program_counter) {
+  // Without the program counter in the run, the window starts at its top
+  long executing = find_instruction(run.instructions, program_counter);
+  long first = std::max((long) 0, executing - GG_FRAME_LINES / 2);
+  assembly_top = run.instructions[first].address;
+  assembly_marker = program_counter;
+  return format_assembly(run.instructions, first, program_counter);
+}
+
+bool GDB::scroll_assembly(long lines, std::string & assembly_code) {
+  const GDBDisassembly * run = interpreter == GDB_INTERPRETER_MI && is_running_program() ?
+    find_disassembly(assembly_top) : nullptr;
+  if (!run) {
+    return false;
+  }
+
+  // More is disassembled once the window runs past either end of the run
+  long top = find_instruction(run->instructions, assembly_top) + lines;
+  if (top < 0) {
+    run = extend_disassembly(*run, true);
+    top = find_instruction(run->instructions, assembly_top) + lines;
+  }
+  else if (top + GG_FRAME_LINES > (long) run->instructions.size()) {
+    run = extend_disassembly(*run, false);
+  }
+
+  top = std::max((long) 0, std::min(top, (long) run->instructions.size() - GG_FRAME_LINES));
+  assembly_top = run->instructions[top].address;
+  assembly_code = format_assembly(run->instructions, top, assembly_marker);
+  return true;
+}
+
+void GDB::refresh(GDBRefresh & refresh) {
+  long starting_round_trips = round_trips;
+  long starting_cache_hits = cache_hits;
+  long starting_cache_misses = cache_misses;
+
+  // The CLI offers no way to tell replies apart, so it asks one at a time
+  if (interpreter == GDB_INTERPRETER_MI && is_running_program()) {
+    refresh_mi(refresh);
+  }
+  else {
+    refresh.source_position = get_source_position();
+    if (!refresh.source_position) {
+      refresh.source_code = get_source_code();
+    }
+    refresh.local_variables = get_local_variables();
+    refresh.formal_parameters = get_formal_parameters();
+    refresh.assembly_code = get_assembly_code();
+    refresh.registers = get_registers();
+    refresh.stack_frame = get_stack_frame();
+  }
+  refresh.status = is_running_program() ? GDB_STATUS_RUNNING : GDB_STATUS_IDLE;
+  refresh.round_trips = round_trips - starting_round_trips;
+
+  if (report_io_stats) {
+    std::cerr << "[gg] refresh: " << refresh.round_trips << " round trips, " <<
+      cache_hits - starting_cache_hits << " cache hits, " << 
+      cache_misses - starting_cache_misses << " cache misses" << std::endl;
+  }
+}
+
+void GDB::refresh_mi(GDBRefresh & refresh) {
+  // The registers a group holds are learned the first time it is shown
+  for (int group = 0; group < GDB_GROUP_COUNT; group++) {
+    if (group_expanded[group]) {
+      learn_register_group((GDBRegisterGroup) group);
+    }
+  }
+
+  // Source comes straight from the file when it can be read, so stepping 
+  // through a file costs GDB nothing for it
+  refresh.source_position = get_source_position();
+  bool list_source = !refresh.source_position;
+
+  // First round trip: everything that only depends on where GDB stopped
+  std::vector<GDBQuery> queries;
+  std::vector<std::string> commands;
+  commands.push_back(GDB_MI_LOCALS);
+  commands.push_back(GDB_MI_ARGUMENTS);
+  commands.push_back(evaluate_address_command(GDB_PROGRAM_COUNTER));
+  commands.push_back(evaluate_address_command(GDB_STACK_POINTER));
+  commands.push_back(evaluate_address_command(GDB_FRAME_POINTER));
+
+  // Register names are learned along the way the first time; after that
+  // only the registers that changed are fetched
+  commands.push_back(GDB_MI_CHANGED_REGISTERS);
+  bool fetch_register_names = register_names.empty();
+  if (fetch_register_names) {
+    commands.push_back(GDB_MI_REGISTER_NAMES);
+    commands.push_back(GDB_MI_CONSOLE " " + mi_quote(GDB_INFO_REGISTERS));
+  }
+
+  // Groups of registers are only fetched while they are shown
+  size_t group_indexes[GDB_GROUP_COUNT];
+  for (int group = 0; group < GDB_GROUP_COUNT; group++) {
+    group_indexes[group] = commands.size();
+    if (group_expanded[group]) {
+      add_register_group_queries((GDBRegisterGroup) group, commands);
+    }
+  }
+
+  // Instructions are disassembled a bounded window at a time; stepping 
+  // inside a window only moves the marker
+  const GDBDisassembly * run = find_disassembly(stopped_address);
+  bool disassemble = !run || !has_window(*run, find_instruction(run->instructions, stopped_address));
+  size_t disassemble_index = commands.size();
+  if (disassemble) {
+    commands.push_back(disassemble_window_command());
+  }
+
+  // Otherwise GDB lists an explicit range, which leaves its list size 
+  // alone; selecting the frame again puts "list" back around the current line
+  size_t list_index = commands.size();
+  if (list_source) {
+    long first_line = std::max((long) 1, saved_line_number - GG_FRAME_LINES / 2);
+    std::string list = std::string(GDB_LIST " ") + std::to_string(first_line) + "," + 
+      std::to_string(first_line + GG_FRAME_LINES - 1);
+    commands.push_back(GDB_MI_CONSOLE " " + mi_quote(list));
+    commands.push_back(GDB_MI_CONSOLE " " + mi_quote(GDB_FRAME));
+  }
+
+  queries.resize(commands.size());
+  for (size_t i = 0; i < commands.size(); i++) {
+    queries[i].command = commands[i];
+  }
+  execute_batch(queries);
+
+  // Source is whatever list printed, or why it couldn't
+  if (list_source) {
+    const GDBQuery & source = queries[list_index];
+    refresh.source_code = source.succeeded ? source.output : 
+      source.result.results.get("msg").str();
+  }
+
+  std::vector<MIVariable> locals;
+  const MIValue * locals_list = queries[0].result.results.find("locals");
+  if (locals_list) {
+    mi_variables(*locals_list, false, locals);
+  }
+  refresh.local_variables = format_variables(locals, GDB_MI_NO_LOCALS);
+
+  std::vector<MIVariable> arguments;
+  const MIValue * frames = queries[1].result.results.find("stack-args");
+  const MIValue * arguments_list = frames && frames->first ? 
+    frames->first->find("args") : nullptr;
+  if (arguments_list) {
+    mi_variables(*arguments_list, true, arguments);
+  }
+  refresh.formal_parameters = format_variables(arguments, GDB_MI_NO_ARGUMENTS);
+
+  // A window that didn't decode in step with the program counter is 
+  // disassembled again from the program counter itself
+  unsigned long program_counter = queries[2].result.results.get("value").to_ulong(0);
+  if (!queries[2].succeeded) {
+    run = nullptr;
+  }
+  else if (disassemble) {
+    const MIValue * listing = queries[disassemble_index].result.results.find("asm_insns");
+    run = listing ? add_disassembly(*listing, true, program_counter) : nullptr;
+  }
+  else {
+    run = find_disassembly(program_counter);
+  }
+  bool disassemble_again = queries[2].succeeded && !run;
+
+  unsigned long stack_pointer = queries[3].result.results.get("value").to_ulong(0);
+  unsigned long frame_pointer = queries[4].result.results.get("value").to_ulong(0);
+  bool has_stack_frame = queries[3].succeeded && queries[4].succeeded &&
+    frame_pointer > stack_pointer;
+
+  if (fetch_register_names) {
+    set_register_names(queries[6].result, queries[7].output);
+  }
+  std::vector<long> changed_registers = get_changed_registers(queries[5].result);
+  for (int group = 0; group < GDB_GROUP_COUNT; group++) {
+    if (group_expanded[group]) {
+      refresh.register_groups[group] = format_register_group((GDBRegisterGroup) group, 
+          &queries[group_indexes[group]]);
+    }
+  }
+
+  // Second round trip: what depends on the answers to the first
+  // The stack of a local inferior is read directly instead
+  commands.clear();
+  MIMemory memory;
+  bool read_stack = has_stack_frame && !read_inferior_memory(stack_pointer, 
+      frame_pointer - stack_pointer + ADDITIONAL_STACK_SPACE, memory);
+  size_t memory_index = commands.size();
+  if (read_stack) {
+    commands.push_back(read_stack_command(stack_pointer, frame_pointer));
+  }
+  size_t registers_index = commands.size();
+  if (!changed_registers.empty()) {
+    commands.push_back(get_register_values_command(GDB_MI_FORMAT_RAW, changed_registers));
+    commands.push_back(get_register_values_command(GDB_MI_FORMAT_NATURAL, changed_registers));
+  }
+  size_t disassemble_again_index = commands.size();
+  if (disassemble_again) {
+    commands.push_back(disassemble_command(std::to_string(program_counter), 
+          std::to_string(program_counter + GG_DISASSEMBLY_AHEAD)));
+  }
+
+  queries.resize(commands.size());
+  for (size_t i = 0; i < commands.size(); i++) {
+    queries[i].command = commands[i];
+  }
+  execute_batch(queries);
+
+  const MIValue * blocks = read_stack ? 
+    queries[memory_index].result.results.find("memory") : nullptr;
+  if (blocks) {
+    mi_memory(*blocks, memory);
+  }
+  refresh.stack_frame = has_stack_frame ? 
+    make_stack_frame(stack_pointer, frame_pointer, memory) : nullptr;
+
+  if (disassemble_again) {
+    const MIValue * listing = queries[disassemble_again_index].result.results.find("asm_insns");
+    run = listing ? add_disassembly(*listing, false, program_counter) : nullptr;
+  }
+  refresh.assembly_code = run ? show_assembly(*run, program_counter) : 
+    std::string(GDB_NO_ASSEMBLY_CODE);
+
+  if (!changed_registers.empty()) {
+    set_register_values(queries[registers_index].result, true);
+    set_register_values(queries[registers_index + 1].result, false);
+  }
+  refresh.register_table = register_table;
+  refresh.registers = format_registers(register_table);
+}
@@ -1,7 +1,23 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
 #include <wx/wx.h>
+#include <wx/collpane.h>
 #include <wx/grid.h>
+#include <wx/vscroll.h>
 
 #include "../include/pstream.hpp"
+#include "mi.hpp"
+#include "syntax.hpp"
 
 #define GG_FRAME_TITLE "GDB Display"
 #define GG_ABOUT_TITLE "About GG"
@@ -10,24 +26,64 @@
 #define GG_LICENSE "GNU GPL v3.0"
 
 #define GG_FRAME_LINES 19
+#define GG_TAB_WIDTH 8
+#define GG_DISASSEMBLY_BEHIND 128
+#define GG_DISASSEMBLY_AHEAD 256
+#define GG_DISASSEMBLY_RESYNC 4
+#define GG_ASSEMBLY_SCROLL_LINES 3
+#define GG_ID_REGISTER_GROUP (wxID_HIGHEST + 1)
 #define GG_HISTORY_MAX_LENGTH 1000
+#define GG_POLL_TIMEOUT_MS 250
+#define GG_PROMPT_SETTLE_MS 50
+#define GG_OUTPUT_BUFFER_SIZE (64 * 1024)
+#define GG_ERROR_BUFFER_SIZE (4 * 1024)
+#define GG_READ_MIN_SPACE 4096
+#define GG_OUTPUT_QUEUE_SIZE (1024 * 1024)
+#define GG_ERROR_QUEUE_SIZE (64 * 1024)
+#define GG_SOURCE_MAP_SIZE (1024 * 1024)
+#define GG_IO_STATS_ENV "GG_IO_STATS"
+#define GG_STACK_PAGE_SIZE 4096
+#define GG_STACK_CACHE_KB (16 * 1024)
+#define GG_STACK_CACHE_ENV "GG_STACK_CACHE_KB"
+#define GG_MEMORY_PAGE_SIZE 4096
+#define GG_MEMORY_ROW_BYTES 16
+#define GG_MEMORY_DEFAULT_LENGTH "65536"
+#define GG_MEMORY_MAX_LENGTH (1UL << 30)
+#define GG_OPTION_CLI "--gg-cli"
 
 #define GDB_PROMPT "(gdb) " 
 #define GDB_QUIT "quit"
 #define GDB_WHERE "where"
 #define GDB_LIST "list" 
-#define GDB_GET_LIST_SIZE "show listsize"
-#define GDB_SET_LIST_SIZE "set listsize"
+#define GDB_FRAME "frame"
 #define GDB_DISASSEMBLE "disassemble"
 #define GDB_INFO_ARGUMENTS "info args"
 #define GDB_INFO_LOCALS "info locals"
 #define GDB_INFO_PROGRAM "info program"
 #define GDB_INFO_REGISTERS "info registers"
+#define GDB_INFO_SOURCE "info source"
+#define GDB_SOURCE_LOCATED "Located in "
 #define GDB_PRINT "p"
 #define GDB_EXAMINE "x"
+#define GDB_EXECUTE_MI "interpreter-exec mi"
+
+#define GDB_MI_INTERPRETER "--interpreter=mi3"
+#define GDB_MI_CONSOLE "-interpreter-exec console"
+#define GDB_MI_LOCALS "-stack-list-locals --all-values"
+#define GDB_MI_ARGUMENTS "-stack-list-arguments --all-values 0 0"
+#define GDB_MI_EVALUATE "-data-evaluate-expression"
+#define GDB_MI_READ_MEMORY "-data-read-memory-bytes"
+#define GDB_MI_DISASSEMBLE_RANGE "-data-disassemble"
+#define GDB_MI_REGISTER_NAMES "-data-list-register-names"
+#define GDB_MI_REGISTER_VALUES "-data-list-register-values --skip-unavailable"
+#define GDB_MI_CHANGED_REGISTERS "-data-list-changed-registers"
+#define GDB_MI_FORMAT_RAW 'x'
+#define GDB_MI_FORMAT_NATURAL 'N'
+#define GDB_MI_FORMAT_BITS 'r'
 
 #define GDB_STACK_POINTER "$sp"
 #define GDB_FRAME_POINTER "$fp"
+#define GDB_PROGRAM_COUNTER "$pc"
 
 #define GDB_MEMORY_TYPE_LONG "x"
 #define GDB_MEMORY_TYPE_INSTRUCTION "i"
@@ -41,6 +97,9 @@
 #define GDB_NO_VARIABLE "No variable information available."
 #define GDB_NO_ASSEMBLY_CODE "No assembly code information available."
 #define GDB_NO_REGISTERS "No register information available."
+#define GDB_NO_MEMORY "Cannot access memory at "
+#define GDB_MI_NO_LOCALS "No locals."
+#define GDB_MI_NO_ARGUMENTS "No arguments."
 
 // Custom event types sent from the console to the GUI for updates.
 const wxEventType GDB_EVT_STATUS_BAR_UPDATE = wxNewEventType();
@@ -50,26 +109,414 @@ const wxEventType GDB_EVT_PARAMS_UPDATE = wxNewEventType();
 const wxEventType GDB_EVT_ASSEMBLY_CODE_UPDATE = wxNewEventType();
 const wxEventType GDB_EVT_REGISTERS_UPDATE = wxNewEventType();
 const wxEventType GDB_EVT_STACK_FRAME_UPDATE = wxNewEventType();
+const wxEventType GDB_EVT_REGISTER_GROUP_UPDATE = wxNewEventType();
+const wxEventType GDB_EVT_MEMORY_VIEW_UPDATE = wxNewEventType();
+const wxEventType GDB_EVT_MEMORY_UPDATE = wxNewEventType();
+const wxEventType GDB_EVT_SYNTAX_UPDATE = wxNewEventType();
+
+// Groups of registers shown on demand, besides the general ones.
+enum GDBRegisterGroup {
+  GDB_GROUP_FLOAT,
+  GDB_GROUP_VECTOR,
+  GDB_GROUP_SYSTEM,
+  GDB_GROUP_COUNT
+};
+
+// Asks the console to move the assembly display by a number of lines; 
+// safe to call from the GUI thread.
+void request_assembly_scroll(long lines);
+
+// Asks the console to start or stop fetching a group of registers; safe
+// to call from the GUI thread.
+void request_register_group(GDBRegisterGroup group, bool shown);
+
+// Asks the console to find the address an expression points at, to show
+// memory from there; safe to call from the GUI thread.
+void request_memory_view(const std::string & expression);
+
+// Asks the console to read a page of memory for the memory view; safe to
+// call from the GUI thread.
+void request_memory_page(unsigned long address);
+
+// A page of the inferior's memory as read for the memory view.
+typedef struct {
+  unsigned long address;
+  std::vector<uint8_t> bytes; // Empty if the page can't be read
+} GDBMemoryPage;
 
 // Represents a location in memory.
 typedef struct {
   long stack_pointer;
   long frame_pointer; 
-  long * memory;
-  long memory_length;
+  std::vector<uint8_t> memory; // The bytes from the stack pointer up
 } StackFrame;
 
+// Counters describing the I/O spent on the most recent GDB command.
+typedef struct {
+  long polls; // poll() calls on GDB's pipes (reader thread)
+  long reads; // read() calls on GDB's pipes (reader thread)
+  long waits; // poll() calls waiting for the reader thread to queue output
+  long pops; // Chunks taken off the reader thread's queues
+  long writes;
+  long bytes_read;
+  long allocations;
+} GDBIOStats;
+
+// Reusable buffer that GDB's pipes are read into directly.
+// Unconsumed bytes stay in place between reads and are only slid back to 
+// the front when the free space at the end runs out, so the same memory 
+// serves every command and only an oversized record forces it to grow.
+class GDBReadBuffer {
+  char * data;
+  size_t capacity;
+  size_t begin; // Offset of the first unconsumed byte
+  size_t end; // Offset one past the last byte read
+  public:
+  // Constructor allocates the initial storage.
+  GDBReadBuffer(size_t initial_capacity);
+
+  // Destructor frees the storage.
+  ~GDBReadBuffer();
+
+  // Makes at least minimum bytes writable after the pending data and returns
+  // where to read into. The writable length is stored in length.
+  // Counts an allocation in stats if the buffer had to grow.
+  char * reserve(size_t minimum, size_t & length, GDBIOStats & stats);
+
+  // Marks length bytes after the pending data as filled by a read.
+  void commit(size_t length) {
+    end += length;
+  }
+
+  // Gets a view of the bytes that have been read but not consumed.
+  // Consumers may rewrite these bytes in place (e.g. to unescape them).
+  char * pending() {
+    return data + begin;
+  }
+
+  // Gets the number of bytes that have been read but not consumed.
+  size_t pending_size() const {
+    return end - begin;
+  }
+
+  // Drops length bytes from the front of the pending data.
+  void consume(size_t length) {
+    begin += length;
+    if (begin == end) {
+      begin = end = 0;
+    }
+  }
+  private:
+  GDBReadBuffer(const GDBReadBuffer &);
+  GDBReadBuffer & operator=(const GDBReadBuffer &);
+};
+
+// Ring of bytes handed from one thread to another without locks. The 
+// producer reads straight into the free space and the consumer copies out 
+// of the used space; each side only ever moves its own index.
+// The capacity must be a power of two.
+class GDBByteQueue {
+  char * data;
+  size_t capacity;
+  std::atomic<size_t> head; // Total bytes pushed, only moved by the producer
+  std::atomic<size_t> tail; // Total bytes popped, only moved by the consumer
+  std::atomic<bool> closed; // Set by the producer once it will push no more
+  public:
+  // Constructor allocates the ring.
+  GDBByteQueue(size_t capacity);
+
+  // Destructor frees the ring.
+  ~GDBByteQueue();
+
+  // Gets where the producer may write next. The contiguous free length is
+  // stored in length, which is 0 while the queue is full.
+  char * free_space(size_t & length);
+
+  // Publishes length bytes written into the free space (producer only).
+  void push(size_t length) {
+    head.store(head.load(std::memory_order_relaxed) + length, std::memory_order_release);
+  }
+
+  // Marks the end of the data (producer only).
+  void close() {
+    closed.store(true, std::memory_order_release);
+  }
+
+  // Copies up to length bytes out of the queue and returns how many were
+  // copied (consumer only). Sets was_full if the producer may be waiting
+  // for the space this freed.
+  size_t pop(char * destination, size_t length, bool & was_full);
+
+  // Returns true if nothing is waiting to be popped.
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+  }
+
+  // Returns true if the producer is done and everything has been popped.
+  bool drained() const {
+    return closed.load(std::memory_order_acquire) && empty();
+  }
+  private:
+  GDBByteQueue(const GDBByteQueue &);
+  GDBByteQueue & operator=(const GDBByteQueue &);
+};
+
+// Streaming recognizer for GDB's prompt.
+// Output is fed through one chunk at a time and only the match position is
+// carried between chunks, so a prompt split across any number of reads is 
+// found in a single pass without re-scanning or concatenating anything.
+// A match is anchored if it starts where GDB itself would print a prompt:
+// at the start of a reply, after a newline or right after another prompt.
+class GDBPromptMatcher {
+  std::string prompt; // The prompt being matched
+  std::vector<size_t> fallback; // Match length to resume from after a mismatch
+  size_t matched; // Number of prompt characters matched at the end of the last chunk
+  bool at_boundary; // Set when the next character begins a line
+  bool match_anchored; // Set when the current match began on a boundary
+  public:
+  // Constructor precomputes the mismatch table for the prompt.
+  GDBPromptMatcher(const char * prompt);
+
+  // Forgets all state; the next character is treated as the start of a reply.
+  void reset();
+
+  // Feeds a chunk of output. Returns true if the chunk ends with a full prompt.
+  bool feed(const char * data, size_t length);
+
+  // Gets the number of trailing characters fed so far that belong to a 
+  // (possibly complete) prompt and so must not be treated as output yet.
+  size_t held() const {
+    return matched;
+  }
+
+  // Returns true if the prompt ending the fed output started on a boundary.
+  bool anchored() const {
+    return match_anchored;
+  }
+};
+
+// A source file in memory, with where each of its lines starts.
+// Lines are sliced straight out of the contents, so showing any part of a 
+// file costs no reads once it is open. Nothing changes once it is open, 
+// so the GUI reads it while GDB's thread holds on to it.
+// Files are read into memory, except for ones of GG_SOURCE_MAP_SIZE or 
+// more, which are mapped. If a mapped file is truncated on disk while it 
+// is shown (e.g. saved in place), touching the pages past its new end 
+// raises SIGBUS before the next stop notices it changed.
+class GDBSourceFile {
+  const char * data; // The contents, null for an empty file
+  size_t size; // Length of the contents
+  std::string copy; // The contents of a file that was read rather than mapped
+  bool mapped; // Set if data is a mapping
+  std::vector<size_t> line_offsets; // Where each line starts, then where the last one ends
+  size_t columns; // Columns of the widest line, with tabs expanded
+  long modified_time; // Modification time when the file was opened
+  public:
+  // Constructor leaves the file unopened.
+  GDBSourceFile() : data(nullptr), size(0), mapped(false), columns(0), modified_time(0) {}
+
+  // Destructor unmaps the file.
+  ~GDBSourceFile();
+
+  // Reads or maps the file at path and indexes its lines. Returns false if it can't
+  // be read, leaving the file unopened.
+  bool open(const std::string & path);
+
+  // Returns true if the file at path no longer is what was opened.
+  bool is_stale(const std::string & path) const;
+
+  // Gets the modification time of the file when it was opened.
+  long get_modified_time() const {
+    return modified_time;
+  }
+
+  // Gets the number of lines in the file.
+  long get_line_count() const {
+    return (long) line_offsets.size() - 1;
+  }
+
+  // Gets the number of columns the widest line takes up.
+  size_t get_columns() const {
+    return columns;
+  }
+
+  // Gets a line (1-based) without its newline, setting length to its length.
+  const char * get_line(long line, size_t & length) const;
+  private:
+  void close();
+
+  GDBSourceFile(const GDBSourceFile &);
+  GDBSourceFile & operator=(const GDBSourceFile &);
+};
+
+// Exposes the pipe descriptors that redi::pstreambuf keeps protected, 
+// so GDB's pipes can be polled, read and written directly.
+class GDBPipes : public redi::pstreambuf {
+  public:
+  // Gets the descriptor of the pipe connected to the process's stdin.
+  static fd_type input_fd(redi::pstream & process) {
+    fd_type & (redi::pstreambuf::*wpipe_of)() = &GDBPipes::wpipe;
+    return (process.rdbuf()->*wpipe_of)();
+  }
+
+  // Gets the descriptor of the pipe connected to the process's stdout.
+  static fd_type output_fd(redi::pstream & process) {
+    return read_fd(process, rsrc_out);
+  }
+
+  // Gets the descriptor of the pipe connected to the process's stderr.
+  static fd_type error_fd(redi::pstream & process) {
+    return read_fd(process, rsrc_err);
+  }
+  private:
+  static fd_type read_fd(redi::pstream & process, buf_read_src source) {
+    fd_type & (redi::pstreambuf::*rpipe_of)(buf_read_src) = &GDBPipes::rpipe;
+    return (process.rdbuf()->*rpipe_of)(source);
+  }
+};
+
+// A register as shown in the registers display.
+typedef struct {
+  long number; // Number GDB knows the register by
+  std::string name;
+  std::string raw; // Value in hex
+  std::string natural; // Value in the register's natural format
+  bool changed; // Set if the value changed at the last stop
+} GDBRegister;
+
+// Lays out a register the way "info registers" does, without a newline.
+std::string format_register(const GDBRegister & reg);
+
+// An MI command sent as part of a batch, with the reply it got.
+typedef struct {
+  std::string command; // The command, without its token
+  MIRecord result; // Its result record, valid until the next MI command
+  std::string output; // Console output GDB printed while running it
+  bool succeeded; // Set if GDB replied and reported success
+  bool cacheable; // Set if the reply may be kept for the rest of the stop
+  std::string record; // The raw result record, kept only if cacheable
+} GDBQuery;
+
+// A run of consecutive instructions, kept across stops since code stays put.
+typedef struct {
+  unsigned long first_address; // Address of the first instruction
+  unsigned long last_address; // Address of the last instruction
+  std::vector<MIInstruction> instructions; // In order of address
+} GDBDisassembly;
+
+// A reply kept to answer a query again while the inferior stays put.
+typedef struct {
+  std::string output; // Console output
+  std::string record; // Raw result record, for MI commands
+} GDBCachedReply;
+
+// A breakpoint location, as reported by GDB.
+typedef struct {
+  std::string path; // Full path of the source file
+  long line;
+} GDBBreakpointLocation;
+
+// Where the program is in a source file that can be read.
+typedef struct {
+  std::string path; // Full path of the file
+  std::shared_ptr<const GDBSourceFile> file;
+  long line; // Line being executed
+  std::vector<long> breakpoint_lines; // Lines with enabled breakpoints, sorted
+} GDBSourcePosition;
+
+// Everything the GUI shows about where the program is, gathered at once.
+typedef struct {
+  std::string status;
+  std::unique_ptr<GDBSourcePosition> source_position; // Null if the file can't be read
+  std::string source_code; // What "list" printed, only without a source position
+  std::string local_variables;
+  std::string formal_parameters;
+  std::string assembly_code;
+  std::string registers;
+  std::vector<GDBRegister> register_table; // The registers as a table (MI only)
+  std::string register_groups[GDB_GROUP_COUNT]; // Groups shown, empty for hidden ones (MI only)
+  std::unique_ptr<StackFrame> stack_frame; // May be null
+  long round_trips; // Number of times gg waited on GDB to gather it all
+} GDBRefresh;
+
+// How long a read of GDB's replies goes on for.
+enum GDBWait {
+  GDB_WAIT_NONE,   // Only handles what GDB has already written
+  GDB_WAIT_RESULT, // Until the result records and the prompt after them
+  GDB_WAIT_STOP    // Also until an inferior the command resumed stops again
+};
+
+// Interpreters GDB can be driven through.
+enum GDBInterpreter {
+  GDB_INTERPRETER_CLI, // Human-readable output, scraped as text
+  GDB_INTERPRETER_MI   // Structured GDB/MI records
+};
+
 // GDB process abstraction.
 class GDB {
+  GDBInterpreter interpreter; // How commands are sent and output is parsed
   redi::pstream process; // The bidirectional stream opened to the process
-  char buf[BUFSIZ]; // Temporary buffer used to read output and error 
-  std::streamsize bufsz; // Number of characters written to temporary buffer at a time
+  int input_fd; // Descriptor of GDB's stdin pipe
+  int output_fd; // Descriptor of GDB's stdout pipe, -1 once it hits EOF (reader only)
+  int error_fd; // Descriptor of GDB's stderr pipe, -1 once it hits EOF (reader only)
+  GDBByteQueue output_queue; // Output the reader thread has read from GDB
+  GDBByteQueue error_queue; // Error the reader thread has read from GDB
+  int output_event[2]; // Pipe the reader thread writes to after queueing anything
+  int reader_event[2]; // Pipe that wakes the reader thread (space freed or stopping)
+  std::atomic<bool> stopping; // Set when the reader thread should exit
+  std::atomic<bool> process_exited; // Set by the reader thread once GDB has exited
+  std::atomic<long> pipe_polls; // poll() calls the reader thread has made
+  std::atomic<long> pipe_reads; // read() calls on GDB's pipes the reader thread has made
+  std::thread reader; // Reads GDB's pipes into the queues as soon as they're written
+  GDBReadBuffer output_data; // Holds output read from GDB until it is consumed
+  GDBReadBuffer error_data; // Holds error read from GDB until it is consumed
+  GDBPromptMatcher prompt_matcher; // Tracks the prompt across output reads
+  GDBIOStats io_stats; // I/O counters for the command currently executing
+  std::string io_stats_command; // The command the I/O counters belong to
+  long io_stats_polls_start; // pipe_polls when the command started
+  long io_stats_reads_start; // pipe_reads when the command started
+  bool report_io_stats; // Set when the counters should be printed after each command
+  long round_trips; // Number of writes to GDB that have awaited a reply
+  long mi_token; // Token of the last MI command sent
+  long pending_token; // Token of the user command whose reply hasn't been read
+  MIArena mi_arena; // Holds the result record of the last MI command
+  MIArena mi_scratch; // Holds records that are dropped as soon as they're handled
+  std::vector<std::string> register_names; // Register names by number, fetched once
+  std::vector<long> general_registers; // Numbers of the registers shown by default
+  std::vector<GDBRegister> register_table; // The registers shown by default, as last fetched (MI only)
+  std::vector<long> group_registers[GDB_GROUP_COUNT]; // Numbers of the registers in each group
+  bool group_known[GDB_GROUP_COUNT]; // Set once a group's registers are learned, when first shown
+  bool group_expanded[GDB_GROUP_COUNT]; // Set while a group is shown (MI only)
   bool running_program; // Cached value specifying if the user is debugging a program in GDB
-  bool running_reset_flag; // Set to true when the value of running_program needs to be updated
+  bool running_reset_flag; // Set to true when the value of running_program needs to be updated (CLI only)
+  long live_inferiors; // Number of inferiors GDB has reported started and not exited (MI only)
+  long inferior_pid; // Process id of the inferior being debugged, 0 if not known
+  std::string inferior_group; // Thread group the process id was reported for (MI only)
+  bool inferior_checked; // Set once it is known whether GDB traces the inferior on this machine
+  bool inferior_local; // Set if it does, so its memory can be read without GDB
+  bool state_changed; // Set when GDB reported a stop, a start, an exit or a frame change (MI only)
+  long stopped_line_number; // Line of the frame GDB last reported (MI only)
+  std::string stopped_source_path; // Full path of the source of that frame (MI only)
+  std::unordered_map<std::string, std::shared_ptr<GDBSourceFile>> source_files; // Open sources, by path
+  std::map<std::string, std::vector<GDBBreakpointLocation>> breakpoints; // Enabled locations, by breakpoint number (MI only)
+  unsigned long stopped_address; // Address of the frame GDB last reported (MI only)
+  std::map<unsigned long, GDBDisassembly> disassemblies; // Runs disassembled so far, by first address
+  unsigned long assembly_top; // Address of the first instruction shown (MI only)
+  unsigned long assembly_marker; // Address of the instruction shown as executing (MI only)
+  std::unordered_map<std::string, GDBCachedReply> reply_cache; // Replies to queries, by command
+  long stop_generation; // Bumped whenever the inferior may have changed, emptying the cache
+  long cache_hits; // Queries answered from the cache
+  long cache_misses; // Cacheable queries that had to be sent
+  bool reply_cached; // Set when the command just executed was answered from the cache
+  std::string cached_reply; // Output of the command answered from the cache
+  bool capturing_reply; // Set while the reply to a cacheable command is being read
+  bool capture_failed; // Set if the reply being captured reported an error
+  std::string capture_command; // The cacheable command whose reply is being read
+  std::string captured_reply; // Output of that command so far
   long saved_line_number; // The last known line we executed
   public:
-  // Class constructor opens the process.
-  GDB(std::vector<std::string> args);
+  // Class constructor opens the process using the given interpreter.
+  GDB(std::vector<std::string> args, GDBInterpreter interpreter);
 
   // Class desctructor closes the process.
   ~GDB(void);
@@ -78,18 +525,77 @@ class GDB {
   void execute(const char * command);
 
   // Read whatever output and error is stored in the process.
-  // Method will try executing non-blocking reads until ... 
-  //  a) the GDB process quits
-  //  b) the prompt is detected at the end of the output buffer
+  // Method sleeps in poll() until GDB writes something, then reads until ... 
+  //  a) the GDB process quits or closes its output
+  //  b) output ends with the prompt and nothing follows it; a prompt that 
+  //     does not start a line (e.g. printed by the inferior) must also be
+  //     followed by GG_PROMPT_SETTLE_MS of silence to count
   void read_until_prompt(std::ostream & output_buffer, std::ostream & error_buffer, bool trim_prompt);
 
-  // Returns true if the GDB process is still alive.
-  bool is_alive();
+  // Gathers everything the GUI shows, sending independent queries to GDB
+  // together rather than waiting on each in turn.
+  void refresh(GDBRefresh & refresh);
+
+  // Gets the number of times the inferior may have changed, which is what
+  // cached replies are valid for.
+  long get_stop_generation() const {
+    return stop_generation;
+  }
+
+  // Gets the number of queries answered from the cache.
+  long get_cache_hits() const {
+    return cache_hits;
+  }
+
+  // Gets the number of cacheable queries that had to be sent to GDB.
+  long get_cache_misses() const {
+    return cache_misses;
+  }
+
+  // Gets the number of times a command has been sent and its reply awaited.
+  long get_round_trips() const {
+    return round_trips;
+  }
+
+  // Handles whatever GDB has written on its own (e.g. output of a running
+  // inferior) without waiting for more.
+  void read_available(std::ostream & output_buffer, std::ostream & error_buffer);
+
+  // Gets a descriptor that becomes readable when GDB has written something,
+  // for waiting on GDB alongside other input.
+  int get_output_event() const {
+    return output_event[0];
+  }
+
+  // Gets the I/O counters for the most recently executed command.
+  const GDBIOStats & get_io_stats() {
+    collect_io_stats();
+    return io_stats;
+  }
+
+  // Returns true if the GDB process is still alive. The reader thread 
+  // watches for GDB exiting, so this makes no system call.
+  bool is_alive() const {
+    return !process_exited.load(std::memory_order_acquire);
+  }
 
   // Returns true if the GDB process is running/debugging a program.
+  // Over MI this is tracked from GDB's notifications and costs no command.
   bool is_running_program();
 
-  // Gets the source code around where GDB is positioned at.
+  // Returns true if what the GUI shows may have changed since the last call:
+  // over MI, when GDB reported the inferior stopping, starting, exiting or
+  // changing frames, or breakpoints changing; over the CLI, when the line 
+  // GDB is at changed. 
+  // Updates the saved line number.
+  bool needs_refresh();
+
+  // Gets the source file GDB is positioned in and the line it is at, or 
+  // null if the file can't be read.
+  std::unique_ptr<GDBSourcePosition> get_source_position();
+
+  // Gets the source code around where GDB is positioned at, as listed by
+  // GDB, for when the file can't be read.
   std::string get_source_code();
 
   // Gets the local variables in the function GDB is executing.
@@ -101,8 +607,9 @@ class GDB {
   // Gets the value of a variable.
   std::string get_variable_value(const char * variable);
 
-  // Gets a heap-allocated StackFrame struct with information about the current stack frame. 
-  StackFrame * get_stack_frame();
+  // Gets a StackFrame struct with information about the current stack frame, 
+  // or null if there is none.
+  std::unique_ptr<StackFrame> get_stack_frame();
 
   // Gets the assembly code for the function GDB is in.
   std::string get_assembly_code();
@@ -110,10 +617,49 @@ class GDB {
   // Gets the register values wherever GDB is stopped at.
   std::string get_registers();
 
-  // Gets GDB's current source code list size.
-  long get_source_list_size();
+  // Moves the assembly shown by the last refresh by a number of lines 
+  // (negative moves up), disassembling more whenever it runs out (MI only).
+  // Returns false if there is no assembly to move.
+  bool scroll_assembly(long lines, std::string & assembly_code);
+
+  // Gets the full path of the source file of the current frame, or an empty
+  // string if GDB doesn't know it. Over MI this is the path of the last 
+  // reported frame and costs no command.
+  std::string get_source_path();
+
+  // Gets a source file in memory. Files stay open across stops
+  // and are only opened again once they change on disk.
+  // Returns null if the file can't be read or doesn't have the given line.
+  std::shared_ptr<GDBSourceFile> open_source_file(const std::string & path, long line_number);
+
+  // Gets the local variables or the arguments of the current frame (MI only).
+  std::vector<MIVariable> get_variables(bool arguments);
+
+  // Gets the registers shown by default. Their names are only fetched 
+  // once and afterwards only the values GDB reports as changed (MI only).
+  const std::vector<GDBRegister> & get_register_table();
+
+  // Shows or hides a group of registers. Shown groups are fetched along
+  // with every refresh and hidden ones never are (MI only).
+  void set_register_group_expanded(GDBRegisterGroup group, bool expanded);
+
+  // Gets the registers of a group, vector registers decoded into lanes of
+  // every width (MI only).
+  std::string get_register_group(GDBRegisterGroup group);
+
+  // Evaluates an expression to an address. One that may change the
+  // inferior, e.g. by calling a function, is always sent to GDB and leaves
+  // the cached replies stale.
+  bool evaluate_address(const char * expression, unsigned long & address);
+
+  // Reads a block of the inferior's memory, straight from its process if 
+  // GDB traces it on this machine and otherwise through GDB as the compact
+  // hex of -data-read-memory-bytes, which the CLI reaches through 
+  // "interpreter-exec mi".
+  bool read_memory(unsigned long address, long length, MIMemory & memory);
 
   // Gets the current line number GDB is positioned at.
+  // Over MI this is the line of the last reported frame and costs no command.
   long get_source_line_number();
 
   // Gets the last line number GDB was positioned at.
@@ -126,6 +672,137 @@ class GDB {
     saved_line_number = line_number;
   }
   private:
+  // Runs on the reader thread, moving GDB's output and error into the
+  // queues and noticing GDB exit, until GDB has closed its pipes and 
+  // exited or the GDB is destroyed.
+  void read_pipes();
+
+  // Checks whether GDB has exited and records it (reader thread only).
+  // Returns true if it just did.
+  bool check_exited();
+
+  // Blocks until output or error is queued, or the timeout expires.
+  // Returns false if there is nothing left to wait on.
+  bool wait_readable(bool & output_ready, bool & error_ready, int timeout_ms);
+
+  // Moves whatever is queued into the given buffer; returns the number of
+  // bytes moved.
+  size_t read_pipe(GDBByteQueue & queue, GDBReadBuffer & buffer);
+
+  // Prints the I/O counters of the last command to stderr if enabled.
+  void print_io_stats();
+
+  // Starts counting the I/O of a command.
+  void start_io_stats(const char * command);
+
+  // Brings the counters of the reader thread's system calls up to date.
+  void collect_io_stats();
+
+  // Writes a line to GDB's stdin and starts counting I/O for the command.
+  void send(const std::string & line, const char * command);
+
+  // Reads MI records, for as long as wait says, of count commands sent 
+  // under consecutive tokens starting at token.
+  // If queries are given, results and console output are stored in them; 
+  // other stream records go to the given streams.
+  void read_mi_reply(long token, std::ostream & output_buffer, std::ostream & error_buffer,
+      GDBQuery * queries, size_t count, GDBWait wait);
+
+  // Executes an MI command and reads its result record.
+  // Returns true if GDB reported success.
+  bool execute_mi(const std::string & command, MIRecord & result);
+
+  // Executes an MI command through the CLI with "interpreter-exec mi".
+  bool execute_mi_from_cli(const std::string & command, MIRecord & result);
+
+  // Executes MI commands with a single write and reads all their replies.
+  // Results stay valid until the next MI command.
+  void execute_batch(std::vector<GDBQuery> & queries);
+
+  // Fills a refresh over MI, in two round trips.
+  void refresh_mi(GDBRefresh & refresh);
+
+  // Learns the register names and which of them are shown by default from
+  // the replies to -data-list-register-names and "info registers".
+  void set_register_names(const MIRecord & names, const std::string & general_output);
+
+  // Remembers the process id of the inferior, 0 if there is none.
+  void set_inferior_pid(long pid);
+
+  // Reads a block of the stopped inferior's memory with process_vm_readv, 
+  // or /proc/<pid>/mem where that isn't allowed, without involving GDB. 
+  // Fails for remote targets and for processes GDB doesn't trace.
+  bool read_inferior_memory(unsigned long address, long length, MIMemory & memory);
+
+  // Gets the numbers of the registers an "info registers" listing shows.
+  std::vector<long> find_register_numbers(const std::string & listing);
+
+  // Learns the register names and the general registers, once.
+  void learn_register_names();
+
+  // Learns which registers a group holds, once.
+  void learn_register_group(GDBRegisterGroup group);
+
+  // Adds the queries fetching the values of a group to a batch.
+  void add_register_group_queries(GDBRegisterGroup group, std::vector<std::string> & commands);
+
+  // Lays out the values of a group from the replies to its queries.
+  std::string format_register_group(GDBRegisterGroup group, const GDBQuery * queries);
+
+  // Works out which registers have to be fetched from the reply to 
+  // -data-list-changed-registers: all of them for a new table, otherwise 
+  // only the changed ones, which are flagged as such.
+  std::vector<long> get_changed_registers(const MIRecord & changed);
+
+  // Sets the raw or natural values of registers from a register-values list.
+  void set_register_values(const MIRecord & values, bool raw);
+
+  // Updates the inferior's state from an exec or notify record.
+  void track_state(const MIRecord & record);
+
+  // Updates the breakpoints from a =breakpoint-created, -modified or 
+  // -deleted notification. Returns true if it was one.
+  bool track_breakpoint(const MIRecord & record);
+
+  // Forgets every cached reply; the inferior may have changed.
+  void invalidate_cache();
+
+  // Writes the reply of a command answered from the cache, if it was.
+  // Returns true if it did.
+  bool write_cached_reply(std::ostream & output_buffer);
+
+  // Keeps the reply that was just read if the command was cacheable and 
+  // succeeded.
+  void finish_capture();
+
+  // Gets the disassembled run with an instruction at an address, or null
+  // if there is none.
+  const GDBDisassembly * find_disassembly(unsigned long address) const;
+
+  // Keeps the instructions listed by -data-disassemble. If the listing was
+  // decoded from a guessed address, its first few instructions are dropped 
+  // as they may not have lined up with the code yet. Returns null if no 
+  // instruction starts at the required address.
+  const GDBDisassembly * add_disassembly(const MIValue & listing, bool guessed_start, 
+      unsigned long required_address);
+
+  // Keeps a run of instructions, replacing whatever it overlaps.
+  const GDBDisassembly * store_disassembly(std::vector<MIInstruction> & instructions);
+
+  // Disassembles a bounded window around the program counter (MI only).
+  const GDBDisassembly * disassemble_around(unsigned long program_counter);
+
+  // Disassembles another window's worth before or after a run (MI only).
+  // Returns the grown run, or the same one if nothing more could be decoded.
+  const GDBDisassembly * extend_disassembly(const GDBDisassembly & run, bool backward);
+
+  // Lays out the instructions of a run centered on the program counter and
+  // remembers where they are for scrolling.
+  std::string show_assembly(const GDBDisassembly & run, unsigned long program_counter);
+
+  // Gets the command that fetches the values of registers in a format.
+  std::string get_register_values_command(char format, const std::vector<long> & numbers);
+
   // Gives option to disable setting internal flags after an execution.
   void execute(const char * command, bool set_flags);
 
@@ -150,28 +827,124 @@ class GDBApp : public wxApp {
     virtual bool OnInit();
 };
 
+// Sets the text of a display, rewriting only the lines between the first
+// and last that differ, so stepping neither lays out the whole display
+// again nor loses its scroll position.
+void update_text(wxTextCtrl * text, const wxString & value);
+
+// Sets the text of a display like the above, and sets first_line and 
+// end_line to the lines that were rewritten (none if they are equal).
+void update_text(wxTextCtrl * text, const wxString & value, long & first_line, long & end_line);
+
+// Lexes C and C++ source files on a thread of its own, once per file and 
+// modification time, so highlighting never holds up showing a stop. Its 
+// owner is sent GDB_EVT_SYNTAX_UPDATE whenever a file is done.
+class GDBHighlighter {
+  // A file lexed or being lexed.
+  typedef struct {
+    long modified_time; // Modification time of the file lexed
+    std::shared_ptr<const SyntaxLines> lines; // Null while being lexed
+  } LexedFile;
+
+  // A file waiting to be lexed.
+  typedef struct {
+    std::string path;
+    std::shared_ptr<const GDBSourceFile> file;
+  } PendingFile;
+
+  std::mutex lock; // Guards everything below
+  std::condition_variable wake; // Signalled when a file is queued or the thread should exit
+  std::unordered_map<std::string, LexedFile> files; // Files lexed or being lexed, by path
+  std::deque<PendingFile> pending; // Files waiting to be lexed, in order
+  std::atomic<bool> stopping; // Set when the thread should exit, also polled while lexing
+  wxEvtHandler * handler; // Sent GDB_EVT_SYNTAX_UPDATE, set at construction
+  std::thread worker; // Lexes the files queued
+  public:
+  // Constructor starts the thread, which sends its updates to handler.
+  GDBHighlighter(wxEvtHandler * handler);
+
+  // Destructor stops the thread, abandoning the file being lexed.
+  ~GDBHighlighter();
+
+  // Gets the spans of the file of a position if it has been lexed;
+  // otherwise queues it to be, unless it isn't C or C++, and returns null.
+  std::shared_ptr<const SyntaxLines> FindLines(const GDBSourcePosition & position);
+  private:
+  // Lexes queued files until the highlighter is destroyed.
+  void Run();
+};
+
+// Shows a whole source file, drawing only the lines on screen straight 
+// from the file in memory, so files of any length open and scroll at once.
+// The line being executed and lines with breakpoints are highlighted.
+// Scrolling sideways leaves the line numbers in place.
+class GDBSourceView : public wxHVScrolledWindow {
+  std::unique_ptr<GDBSourcePosition> position; // File shown, null when showing text
+  std::shared_ptr<const SyntaxLines> syntaxLines; // Highlighting of the file, null until lexed
+  GDBHighlighter highlighter; // Lexes files in the background
+  std::vector<std::string> textLines; // Lines shown when there's no file
+  int lineHeight; // Height of every line
+  int charWidth; // Width of every column
+  int numberDigits; // Width of the line numbers
+  public:
+  // Constructor for the view.
+  GDBSourceView(wxWindow * parent);
+
+  // Shows where the program is in a file, scrolling to the line being
+  // executed unless it is already in view.
+  void SetPosition(std::unique_ptr<GDBSourcePosition> position);
+
+  // Shows text in place of a file, e.g. what "list" printed.
+  void SetText(const std::string & text);
+
+  wxCoord OnGetRowHeight(size_t row) const {
+    return lineHeight;
+  }
+
+  wxCoord OnGetColumnWidth(size_t column) const {
+    return charWidth;
+  }
+  private:
+  // Gets the number of columns the line numbers take up, with the space
+  // after them.
+  size_t GetGutterColumns() const {
+    return position ? numberDigits + 2 : 0;
+  }
+
+  // Draws the lines in view.
+  void OnPaint(wxPaintEvent & event);
+
+  // Draws the file again once the highlighter is done with it.
+  void OnSyntaxUpdate(wxCommandEvent & event);
+};
+
 // GUI display for source code, local variables, formal parameters.
 class GDBSourcePanel : public wxPanel {
-  wxTextCtrl * sourceCodeText; // Displays source code 
+  GDBSourceView * sourceView; // Displays source code 
   wxTextCtrl * localsText; // Displays local variables
   wxTextCtrl * paramsText; // Displays formal parameters
   public:
   // Constructor for the panel.
   GDBSourcePanel(wxWindow * parent);
 
+  // Sets the source code display to a file.
+  void SetSourcePosition(std::unique_ptr<GDBSourcePosition> position) {
+    sourceView->SetPosition(std::move(position));
+  }
+
   // Sets the text of the source code display.
   void SetSourceCode(wxString value) {
-    sourceCodeText->SetValue(value);
+    sourceView->SetText(std::string(value.utf8_str()));
   }
 
   // Sets the text of the local variables display.
   void SetLocalVariables(wxString value) {
-    localsText->SetValue(value);
+    update_text(localsText, value);
   }
 
   // Sets the text of the formal parameters display.
   void SetFormalParameters(wxString value) {
-    paramsText->SetValue(value);
+    update_text(paramsText, value);
   }
 }; 
 
@@ -179,37 +952,214 @@ class GDBSourcePanel : public wxPanel {
 class GDBAssemblyPanel : public wxPanel {
   wxTextCtrl * assemblyCodeText; // Displays assembly code
   wxTextCtrl * registersText; // Displays register values
+  std::vector<GDBRegister> shownRegisters; // Registers displayed, if set from a table
+  wxCollapsiblePane * groupPanes[GDB_GROUP_COUNT]; // Expand to show each group of registers
+  wxTextCtrl * groupTexts[GDB_GROUP_COUNT]; // Displays the registers of each group
   public:
   // Constructor for the panel.
   GDBAssemblyPanel(wxWindow * parent);
 
-  // Sets the text of the assembly code display.
-  void SetAssemblyCode(wxString value) {
-    assemblyCodeText->SetValue(value);
-  }
+  // Sets the text of the assembly code display, highlighting the lines
+  // that were rewritten.
+  void SetAssemblyCode(wxString value);
 
   // Sets the text of the registers display.
   void SetRegisters(wxString value) {
-    registersText->SetValue(value);
+    shownRegisters.clear();
+    update_text(registersText, value);
+  }
+
+  // Sets the registers display from a table, highlighting the registers
+  // that changed. When it already shows the same registers, only the rows
+  // whose values changed are rewritten.
+  // Note that the table is deleted after this function call.
+  void SetRegisterTable(std::vector<GDBRegister> * registers);
+
+  // Sets the text of a group of registers.
+  void SetRegisterGroup(int group, wxString value) {
+    update_text(groupTexts[group], value);
+  }
+  private:
+  // Called when the user expands or collapses a group of registers; groups
+  // are only fetched while expanded.
+  void OnRegisterGroupToggled(wxCollapsiblePaneEvent & event);
+
+  // Called when the user scrolls the assembly display with the mouse wheel;
+  // only a window of instructions is shown, so the console moves it.
+  void OnAssemblyWheel(wxMouseEvent & event);
+};
+
+// A page of the stack as last seen by the stack panel.
+typedef struct {
+  std::vector<uint8_t> bytes; // GG_STACK_PAGE_SIZE bytes, 0 where never fetched
+  long known_begin; // Offset of the first byte fetched
+  long known_end; // Offset past the last byte fetched
+  long last_seen; // Frame the page was last fetched with
+  std::list<long>::iterator lru_entry; // Place in stack_lru
+  uint64_t hash; // Hash of the bytes fetched, to tell quickly if they changed
+  std::vector<uint8_t> changed; // 1 for each byte changed by the last frame, empty if none
+} GDBStackPage;
+
+// Presents the stack pages to the stack grid, which asks for the values,
+// labels and colours of the cells it draws as it draws them, so only what
+// is on screen is ever formatted.
+class GDBStackTable : public wxGridTableBase {
+  // Where the rows of a page start.
+  typedef struct {
+    long first_row;
+    long address;
+    const GDBStackPage * page;
+  } PageRows;
+
+  std::vector<PageRows> page_rows; // Every page shown, by address
+  long rows; // Number of rows shown
+  long stack_pointer; // Stack pointer of the frame shown
+  long frame_pointer; // Frame pointer of the frame shown
+  wxGridCellAttr * garbage_attr; // Rows above the stack pointer
+  wxGridCellAttr * stack_pointer_attr; // Address of the stack pointer
+  wxGridCellAttr * frame_pointer_attr; // Address of the frame pointer
+  wxGridCellAttr * changed_attr; // Bytes changed since the last stop
+  wxGridCellAttr * changed_garbage_attr; // Bytes changed above the stack pointer
+  public:
+  GDBStackTable();
+
+  ~GDBStackTable();
+
+  // Shows the known parts of the pages as rows of 4 bytes, and tells the
+  // grid how many rows were added or removed. The pages must stay alive
+  // and unchanged until this is called again.
+  void SetStack(const std::map<long, GDBStackPage> & pages, long stack_pointer, 
+      long frame_pointer);
+
+  int GetNumberRows() {
+    return rows;
+  }
+
+  int GetNumberCols() {
+    return 5;
+  }
+
+  bool IsEmptyCell(int row, int col) {
+    return GetValue(row, col).IsEmpty();
   }
+
+  wxString GetValue(int row, int col);
+
+  // The stack can't be edited.
+  void SetValue(int row, int col, const wxString & value) {}
+
+  wxString GetColLabelValue(int col);
+
+  wxString GetRowLabelValue(int row);
+
+  wxGridCellAttr * GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind);
+  private:
+  // Finds the page a row belongs to and the address the row starts at.
+  const PageRows * FindRow(int row, long & address) const;
 };
 
 // GUI display for stack frame
 class GDBStackPanel : public wxPanel {
   wxGrid * grid;
-  long * stack_global;
-  long stack_size;
-  long stack_top;
+  GDBStackTable * table; // Owned by the grid
+  std::map<long, GDBStackPage> stack_pages; // Pages of the stack seen so far, by address
+  std::list<long> stack_lru; // Addresses of the pages, most recently seen first
+  long stack_frames; // Number of frames merged so far
+  size_t stack_max_pages; // Pages kept before the least recently seen are dropped
+  std::vector<long> changed_pages; // Pages with bytes changed by the last frame
   public:
   // Constructor for the panel.
   GDBStackPanel(wxWindow * parent);
 
-  // Deconstructor for the panel.
-  ~GDBStackPanel();
+  // Sets the grid of the stack frame, merging its memory into the stack
+  // seen so far; a null frame clears it.
+  void SetStackFrame(std::unique_ptr<StackFrame> stack_frame);
+  private:
+  // Copies fetched bytes into a page seen before, marking those that 
+  // changed.
+  void MergeStackPage(GDBStackPage & page, long offset, long length, const uint8_t * fetched);
+};
+
+// Presents a range of memory to the memory grid as a hex dump, 16 bytes a
+// row. Pages are only asked of the console once a row of theirs is drawn,
+// along with the page after it, and are kept until the inferior moves.
+class GDBMemoryTable : public wxGridTableBase {
+  // A page read since the inferior last stopped.
+  typedef struct {
+    std::vector<uint8_t> bytes; // Empty if the page can't be read
+    uint64_t hash; // Hash of the bytes, to tell quickly if they changed
+    std::vector<uint8_t> changed; // 1 for each byte changed since the stop before, empty if none
+  } CachedPage;
 
-  // Sets the grid of the stack frame.
-  // Note that the stack_frame data is deleted after this function call.
-  void SetStackFrame(StackFrame * stack_frame);
+  unsigned long begin; // Address of the first byte shown
+  unsigned long length; // Number of bytes shown
+  long rows; // Number of rows shown
+  std::unordered_map<unsigned long, CachedPage> pages; // Pages read, by address
+  std::unordered_map<unsigned long, CachedPage> previous_pages; // Pages read before the last stop
+  std::unordered_set<unsigned long> requested; // Pages asked for and not yet read
+  wxGridCellAttr * changed_attr; // Bytes changed since the stop before
+  public:
+  GDBMemoryTable();
+
+  ~GDBMemoryTable();
+
+  // Shows a range of memory, and tells the grid how many rows were added
+  // or removed.
+  void SetRange(unsigned long begin, unsigned long length);
+
+  // Keeps a page that was read, marking the bytes that changed since it
+  // was read before the last stop.
+  void SetPage(std::unique_ptr<GDBMemoryPage> page);
+
+  // Sets aside every page, since the inferior may have changed them.
+  void ClearPages();
+
+  int GetNumberRows() {
+    return rows;
+  }
+
+  // The address, a column for each byte of a row, and the row as text.
+  int GetNumberCols() {
+    return GG_MEMORY_ROW_BYTES + 2;
+  }
+
+  bool IsEmptyCell(int row, int col) {
+    return row < 0 || row >= rows;
+  }
+
+  wxString GetValue(int row, int col);
+
+  // Memory can't be edited.
+  void SetValue(int row, int col, const wxString & value) {}
+
+  wxString GetColLabelValue(int col);
+
+  wxGridCellAttr * GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind);
+  private:
+  // Gets the page holding an address, asking for it and the page after it
+  // if they haven't been read; null until it has been.
+  const CachedPage * FindPage(unsigned long address);
+};
+
+// GUI display for any range of memory
+class GDBMemoryPanel : public wxPanel {
+  wxTextCtrl * addressText; // Expression giving the first address shown
+  wxTextCtrl * lengthText; // Number of bytes shown
+  wxGrid * grid;
+  GDBMemoryTable * table; // Owned by the grid
+  public:
+  // Constructor for the panel.
+  GDBMemoryPanel(wxWindow * parent);
+
+  // Shows memory from an address, or nothing if the expression entered
+  // couldn't be evaluated.
+  void SetMemoryView(bool found, unsigned long address);
+
+  // Shows a page that was read, or forgets every page if it is null.
+  void SetMemoryPage(std::unique_ptr<GDBMemoryPage> page);
+  private:
+  // Called when the user presses enter in the address or length fields.
+  void OnMemoryViewEntered(wxCommandEvent & event);
 };
 
 // GUI top level display frame.
@@ -219,6 +1169,7 @@ class GDBFrame : public wxFrame {
   GDBSourcePanel * sourcePanel;
   GDBAssemblyPanel * assemblyPanel;
   GDBStackPanel * stackPanel;
+  GDBMemoryPanel * memoryPanel;
   public:
   // Called by GDBApp::OnInit() when it is initializing the top level frame.
   GDBFrame(const wxString & title, 
@@ -240,7 +1191,13 @@ class GDBFrame : public wxFrame {
 
   // Source code display should be updated.
   void DoSourceCodeUpdate(wxCommandEvent & event) {
-    sourcePanel->SetSourceCode(event.GetString());
+    std::unique_ptr<GDBSourcePosition> position((GDBSourcePosition *) event.GetClientData());
+    if (position) {
+      sourcePanel->SetSourcePosition(std::move(position));
+    }
+    else {
+      sourcePanel->SetSourceCode(event.GetString());
+    }
   }
 
   // Local variable display should be updated.
@@ -260,12 +1217,37 @@ class GDBFrame : public wxFrame {
 
   // Registers display should be updated.
   void DoRegistersUpdate(wxCommandEvent & event) {
-    assemblyPanel->SetRegisters(event.GetString());
+    std::vector<GDBRegister> * registers = (std::vector<GDBRegister> *) event.GetClientData();
+    if (registers) {
+      assemblyPanel->SetRegisterTable(registers);
+    }
+    else {
+      assemblyPanel->SetRegisters(event.GetString());
+    }
+  }
+
+  // A group of registers should be updated.
+  void DoRegisterGroupUpdate(wxCommandEvent & event) {
+    assemblyPanel->SetRegisterGroup(event.GetInt(), event.GetString());
   }
 
   void DoStackFrameUpdate(wxCommandEvent & event) {
-    StackFrame * stack_frame = (StackFrame *) event.GetClientData();
-    stackPanel->SetStackFrame(stack_frame);
+    std::unique_ptr<StackFrame> stack_frame((StackFrame *) event.GetClientData());
+    stackPanel->SetStackFrame(std::move(stack_frame));
+  }
+
+  // The memory display should show memory from another address.
+  void DoMemoryViewUpdate(wxCommandEvent & event) {
+    memoryPanel->SetMemoryView(event.GetInt(), (unsigned long) event.GetExtraLong());
+    if (!event.GetInt()) {
+      SetStatusText(GDB_NO_MEMORY + event.GetString());
+    }
+  }
+
+  // A page of memory was read, or the inferior moved if there is none.
+  void DoMemoryUpdate(wxCommandEvent & event) {
+    std::unique_ptr<GDBMemoryPage> page((GDBMemoryPage *) event.GetClientData());
+    memoryPanel->SetMemoryPage(std::move(page));
   }
 
   // Macro to specify that this frame has events that need binding
@@ -1,9 +1,16 @@
 #include <wx/notebook.h>
+#include <wx/collpane.h>
 #include <wx/gbsizer.h>
 #include <wx/grid.h>
 #include <wx/dataview.h>
+#include <wx/dcbuffer.h>
+#include <algorithm>
 #include <sstream>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "gg.hpp" 
 
 std::string long_to_string(long value, int use_hex) {
@@ -15,6 +22,117 @@ std::string long_to_string(long value, int use_hex) {
   return conversion.str();
 }
 
+// Hashes bytes 8 at a time, to tell whether memory changed between stops
+// without comparing it byte by byte.
+uint64_t hash_bytes(const uint8_t * bytes, size_t length) {
+  uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+  size_t index = 0;
+  for (; index + sizeof(uint64_t) <= length; index += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + index, sizeof(uint64_t));
+    hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 32;
+  }
+  for (; index < length; index++) {
+    hash = (hash ^ bytes[index]) * 0x100000001b3ULL;
+  }
+  return hash ^ (hash >> 29);
+}
+
+// Marks each byte that differs between old and new bytes with a 1, 16 at
+// a time where SSE2 is available; returns the number of bytes changed.
+size_t diff_bytes(const uint8_t * old_bytes, const uint8_t * new_bytes, size_t length, 
+    uint8_t * changed) 
+{
+  size_t count = 0;
+  size_t index = 0;
+#if defined(__SSE2__)
+  for (; index + 16 <= length; index += 16) {
+    __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (old_bytes + index)), 
+        _mm_loadu_si128((const __m128i *) (new_bytes + index)));
+    _mm_storeu_si128((__m128i *) (changed + index), _mm_andnot_si128(equal, _mm_set1_epi8(1)));
+    count += __builtin_popcount(~_mm_movemask_epi8(equal) & 0xffff);
+  }
+#endif
+  for (; index < length; index++) {
+    changed[index] = old_bytes[index] != new_bytes[index];
+    count += changed[index];
+  }
+  return count;
+}
+
+void update_text(wxTextCtrl * text, const wxString & value) {
+  long first_line;
+  long end_line;
+  update_text(text, value, first_line, end_line);
+}
+
+void update_text(wxTextCtrl * text, const wxString & value, long & first_line, long & end_line) {
+  first_line = 0;
+  end_line = 0;
+  wxString shown = text->GetValue();
+  if (shown == value) {
+    return;
+  }
+
+  // Find the lines both start with
+  size_t prefix = 0;
+  size_t line = 0;
+  size_t common = std::min(shown.length(), value.length());
+  for (size_t index = 0; index < common && shown[index] == value[index]; index++) {
+    if (shown[index] == '\n') {
+      prefix = index + 1;
+      line++;
+    }
+  }
+
+  // Find the lines both end with, which the prefix can't overlap
+  size_t suffix = 0;
+  for (size_t index = 1; index <= common - prefix && 
+      shown[shown.length() - index] == value[value.length() - index]; index++) {
+    if (shown[shown.length() - index] == '\n') {
+      suffix = index - 1;
+    }
+  }
+
+  // Positions come from lines, since the display may count newlines 
+  // differently than the string does
+  long start = text->XYToPosition(0, line);
+  long end = text->GetLastPosition();
+  if (suffix) {
+    size_t shown_end_line = line;
+    for (size_t index = prefix; index < shown.length() - suffix; index++) {
+      shown_end_line += shown[index] == '\n';
+    }
+    end = text->XYToPosition(0, shown_end_line);
+  }
+  wxString replacement = value.Mid(prefix, value.length() - suffix - prefix);
+  text->Replace(start, end, replacement);
+  first_line = line;
+  end_line = line + 1;
+  for (size_t index = 0; index < replacement.length(); index++) {
+    end_line += replacement[index] == '\n';
+  }
+}
+
+// Colours of each kind of token.
+static const unsigned char syntax_colours[SYNTAX_KIND_COUNT][3] = {
+  { 0, 0, 0 },       // Plain
+  { 0, 0, 192 },     // Keyword
+  { 0, 128, 128 },   // Type
+  { 163, 21, 21 },   // String
+  { 9, 134, 88 },    // Number
+  { 0, 128, 0 },     // Comment
+  { 128, 64, 128 },  // Preprocessor
+  { 128, 64, 0 },    // Register
+  { 0, 96, 160 },    // Symbol
+  { 128, 128, 128 }  // Address
+};
+
+wxColour syntax_colour(SyntaxKind kind) {
+  return wxColour(syntax_colours[kind][0], syntax_colours[kind][1], syntax_colours[kind][2]);
+}
+
 bool GDBApp::OnInit() {
   // Determine screen and application dimensions
   long screen_x = wxSystemSettings::GetMetric(wxSYS_SCREEN_X);
@@ -81,6 +199,10 @@ GDBFrame::GDBFrame(const wxString & title,
   // Create stack frame display
   stackPanel = new GDBStackPanel(tabs);
   tabs->AddPage(stackPanel, "Stack Frames");
+
+  // Create memory display
+  memoryPanel = new GDBMemoryPanel(tabs);
+  tabs->AddPage(memoryPanel, "Memory");
 }
 
 void GDBFrame::OnAbout(wxCommandEvent & event) {
@@ -104,6 +226,234 @@ void GDBFrame::OnAbout(wxCommandEvent & event) {
   wxMessageBox(text, GG_ABOUT_TITLE, wxOK | wxICON_INFORMATION);
 }
 
+// Expands tabs to every 8 columns, the way "list" output shows in a terminal.
+// Column is where the text starts, and is moved past it.
+std::string expand_tabs(const char * text, size_t length, size_t & column) {
+  std::string expanded;
+  expanded.reserve(length);
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] == '\t') {
+      expanded.append(GG_TAB_WIDTH - column % GG_TAB_WIDTH, ' ');
+      column += GG_TAB_WIDTH - column % GG_TAB_WIDTH;
+    }
+    else {
+      expanded += text[i];
+
+      // Only the first byte of a UTF-8 sequence takes a column
+      column += (text[i] & 0xc0) != 0x80;
+    }
+  }
+  return expanded;
+}
+
+// Draws text starting at a column of a line in a fixed width font; 
+// returns the column after it.
+size_t draw_text(wxDC & dc, const char * text, size_t length, size_t column, 
+    int x, int y, int char_width)
+{
+  int left = x + column * char_width;
+  std::string expanded = expand_tabs(text, length, column);
+  dc.DrawText(wxString::FromUTF8(expanded.data(), expanded.size()), left, y);
+  return column;
+}
+
+GDBHighlighter::GDBHighlighter(wxEvtHandler * handler) : stopping(false), handler(handler) {
+  worker = std::thread(&GDBHighlighter::Run, this);
+}
+
+GDBHighlighter::~GDBHighlighter() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+std::shared_ptr<const SyntaxLines> GDBHighlighter::FindLines(const GDBSourcePosition & position) {
+  if (!syntax_is_c_path(position.path)) {
+    return nullptr;
+  }
+
+  // A file is lexed again only once it changed on disk
+  std::lock_guard<std::mutex> guard(lock);
+  std::unordered_map<std::string, LexedFile>::iterator found = files.find(position.path);
+  long modified_time = position.file->get_modified_time();
+  if (found != files.end() && found->second.modified_time == modified_time) {
+    return found->second.lines;
+  }
+  LexedFile & lexed = files[position.path];
+  lexed.modified_time = modified_time;
+  lexed.lines.reset();
+  PendingFile file = { position.path, position.file };
+  pending.push_back(file);
+  wake.notify_one();
+  return nullptr;
+}
+
+void GDBHighlighter::Run() {
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    while (!stopping && pending.empty()) {
+      wake.wait(guard);
+    }
+    if (stopping) {
+      return;
+    }
+    PendingFile file = pending.front();
+    pending.pop_front();
+
+    // The file can't change under the lexer, so it is read unlocked; 
+    // closing gg doesn't wait for the rest of a large file
+    guard.unlock();
+    std::shared_ptr<SyntaxLines> lines(new SyntaxLines());
+    long line_count = file.file->get_line_count();
+    for (long line = 1; line <= line_count && !stopping.load(std::memory_order_relaxed); line++) {
+      size_t length;
+      const char * text = file.file->get_line(line, length);
+      lines->add_c_line(text, length);
+    }
+    guard.lock();
+    if (stopping) {
+      return;
+    }
+
+    // Keep it unless a newer version of the file was asked for meanwhile
+    std::unordered_map<std::string, LexedFile>::iterator lexed = files.find(file.path);
+    if (lexed != files.end() && lexed->second.modified_time == file.file->get_modified_time()) {
+      lexed->second.lines = lines;
+    }
+    handler->QueueEvent(new wxCommandEvent(GDB_EVT_SYNTAX_UPDATE));
+  }
+}
+
+GDBSourceView::GDBSourceView(wxWindow * parent) :
+  wxHVScrolledWindow(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, 
+      wxBORDER_SUNKEN | wxFULL_REPAINT_ON_RESIZE),
+  highlighter(this),
+  numberDigits(1)
+{
+  SetBackgroundStyle(wxBG_STYLE_PAINT);
+  SetFont(wxFont(10, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+  lineHeight = GetCharHeight();
+  charWidth = GetCharWidth();
+  Bind(wxEVT_PAINT, &GDBSourceView::OnPaint, this);
+  Bind(wxEventTypeTag<wxCommandEvent>(GDB_EVT_SYNTAX_UPDATE), &GDBSourceView::OnSyntaxUpdate, this);
+  SetText(GDB_NO_SOURCE_CODE);
+}
+
+void GDBSourceView::SetPosition(std::unique_ptr<GDBSourcePosition> position) {
+  bool same_file = this->position && this->position->file == position->file;
+  this->position = std::move(position);
+  textLines.clear();
+  if (!same_file) {
+    syntaxLines = highlighter.FindLines(*this->position);
+    long lines = this->position->file->get_line_count();
+    numberDigits = std::to_string(lines).size();
+    SetRowColumnCount(lines, GetGutterColumns() + this->position->file->get_columns());
+    ScrollToColumn(0);
+  }
+
+  // Moving within a file only scrolls it, and only once the line leaves the view
+  size_t row = this->position->line - 1;
+  if (!same_file || !IsRowVisible(row)) {
+    size_t shown = GetVisibleRowsEnd() - GetVisibleRowsBegin();
+    ScrollToRow(row > shown / 2 ? row - shown / 2 : 0);
+  }
+  Refresh();
+}
+
+void GDBSourceView::SetText(const std::string & text) {
+  position.reset();
+  syntaxLines.reset();
+  textLines.clear();
+  size_t columns = 0;
+  for (size_t begin = 0; begin < text.size(); ) {
+    size_t end = std::min(text.find('\n', begin), text.size());
+    textLines.push_back(text.substr(begin, end - begin));
+    size_t column = 0;
+    expand_tabs(text.data() + begin, end - begin, column);
+    columns = std::max(columns, column);
+    begin = end + 1;
+  }
+  SetRowColumnCount(textLines.size(), columns);
+  ScrollToRow(0);
+  ScrollToColumn(0);
+  Refresh();
+}
+
+void GDBSourceView::OnSyntaxUpdate(wxCommandEvent & event) {
+  if (position && !syntaxLines) {
+    syntaxLines = highlighter.FindLines(*position);
+    if (syntaxLines) {
+      Refresh();
+    }
+  }
+}
+
+void GDBSourceView::OnPaint(wxPaintEvent & event) {
+  wxAutoBufferedPaintDC dc(this);
+  dc.SetBackground(wxBrush(*wxWHITE));
+  dc.Clear();
+  dc.SetFont(GetFont());
+  dc.SetPen(*wxTRANSPARENT_PEN);
+  int width = GetClientSize().GetWidth();
+  int char_width = charWidth;
+  int gutter = (numberDigits + 1) * char_width;
+
+  // Rows are drawn from the top whatever the first row in view is, and 
+  // text from whatever column is scrolled to the left edge of the text
+  size_t first = GetVisibleRowsBegin();
+  int scroll = GetVisibleColumnsBegin() * char_width;
+  int text_left = GetGutterColumns() * char_width;
+  for (size_t row = first; row < GetVisibleRowsEnd(); row++) {
+    int y = (row - first) * lineHeight;
+    if (!position) {
+      dc.SetTextForeground(*wxBLACK);
+      draw_text(dc, textLines[row].data(), textLines[row].size(), 0, -scroll, y, char_width);
+      continue;
+    }
+
+    // Highlight the line being executed, and mark lines with breakpoints
+    // next to their numbers
+    long line = row + 1;
+    if (line == position->line) {
+      dc.SetBrush(wxBrush(wxColour(255, 255, 124)));
+      dc.DrawRectangle(0, y, width, lineHeight);
+    }
+    if (std::binary_search(position->breakpoint_lines.begin(), 
+          position->breakpoint_lines.end(), line)) {
+      dc.SetBrush(wxBrush(wxColour(230, 90, 90)));
+      dc.DrawRectangle(0, y, gutter, lineHeight);
+    }
+
+    char number[32];
+    snprintf(number, sizeof(number), "%*ld", numberDigits, line);
+    dc.SetTextForeground(wxColour(128, 128, 128));
+    dc.DrawText(number, 0, y);
+
+    // Lines are drawn a token at a time, in plain black until the file 
+    // has been highlighted, and never over the line numbers
+    size_t length;
+    const char * text = position->file->get_line(line, length);
+    size_t span_count = 0;
+    const SyntaxSpan * spans = syntaxLines ? syntaxLines->get_line(line, span_count) : nullptr;
+    wxDCClipper clipper(dc, text_left, y, std::max(width - text_left, 0), lineHeight);
+    int left = text_left - scroll;
+    size_t column = 0;
+    size_t drawn = 0;
+    for (size_t i = 0; i < span_count && spans[i].begin + spans[i].length <= length; i++) {
+      dc.SetTextForeground(*wxBLACK);
+      column = draw_text(dc, text + drawn, spans[i].begin - drawn, column, left, y, char_width);
+      dc.SetTextForeground(syntax_colour(spans[i].kind));
+      column = draw_text(dc, text + spans[i].begin, spans[i].length, column, left, y, char_width);
+      drawn = spans[i].begin + spans[i].length;
+    }
+    dc.SetTextForeground(*wxBLACK);
+    draw_text(dc, text + drawn, length - drawn, column, left, y, char_width);
+  }
+}
+
 GDBSourcePanel::GDBSourcePanel(wxWindow * parent) :
   wxPanel(parent, wxID_ANY) 
 {
@@ -115,10 +465,8 @@ GDBSourcePanel::GDBSourcePanel(wxWindow * parent) :
   long textCtrlStyle = wxTE_MULTILINE | wxTE_READONLY | wxTE_RICH | wxHSCROLL | wxVSCROLL;
 
   // Create source code display and add to sizer
-  sourceCodeText = new wxTextCtrl(this, wxID_ANY, 
-      wxT(GDB_NO_SOURCE_CODE),
-      wxDefaultPosition, wxDefaultSize, textCtrlStyle);
-  sizer->Add(sourceCodeText, 
+  sourceView = new GDBSourceView(this);
+  sizer->Add(sourceView, 
       wxGBPosition(0, 0), wxGBSpan(2, 1), 
       wxALL | wxEXPAND, 5);
 
@@ -160,12 +508,32 @@ GDBAssemblyPanel::GDBAssemblyPanel(wxWindow * parent) :
       wxT(GDB_NO_ASSEMBLY_CODE),
       wxDefaultPosition, wxDefaultSize, textCtrlStyle);
   sizer->Add(assemblyCodeText, wxGBPosition(0, 0), wxGBSpan(2, 1), wxALL | wxEXPAND, 5);
+  assemblyCodeText->Bind(wxEVT_MOUSEWHEEL, &GDBAssemblyPanel::OnAssemblyWheel, this);
 
-  // Create registers display and add to sizer
+  // Create registers display, with the groups of registers that are only
+  // fetched while expanded below it, and add to sizer
+  wxBoxSizer * registersSizer = new wxBoxSizer(wxVERTICAL);
   registersText = new wxTextCtrl(this, wxID_ANY, 
       wxT(GDB_NO_REGISTERS),
       wxDefaultPosition, wxDefaultSize, textCtrlStyle);
-  sizer->Add(registersText, wxGBPosition(0, 1), wxGBSpan(2, 1), wxALL | wxEXPAND, 5);
+  registersSizer->Add(registersText, 1, wxEXPAND);
+
+  const char * groupLabels[GDB_GROUP_COUNT] = { "Float", "Vector", "System" };
+  for (int group = 0; group < GDB_GROUP_COUNT; group++) {
+    groupPanes[group] = new wxCollapsiblePane(this, GG_ID_REGISTER_GROUP + group, 
+        groupLabels[group]);
+    wxWindow * pane = groupPanes[group]->GetPane();
+    groupTexts[group] = new wxTextCtrl(pane, wxID_ANY, 
+        wxT(GDB_NO_REGISTERS),
+        wxDefaultPosition, wxSize(-1, 200), textCtrlStyle);
+    wxBoxSizer * paneSizer = new wxBoxSizer(wxVERTICAL);
+    paneSizer->Add(groupTexts[group], 1, wxEXPAND);
+    pane->SetSizer(paneSizer);
+    registersSizer->Add(groupPanes[group], 0, wxEXPAND);
+    groupPanes[group]->Bind(wxEVT_COLLAPSIBLEPANE_CHANGED, 
+        &GDBAssemblyPanel::OnRegisterGroupToggled, this);
+  }
+  sizer->Add(registersSizer, wxGBPosition(0, 1), wxGBSpan(2, 1), wxALL | wxEXPAND, 5);
 
   // Specify sizer rows and columns that should be growable
   sizer->AddGrowableRow(0, 1);
@@ -174,21 +542,242 @@ GDBAssemblyPanel::GDBAssemblyPanel(wxWindow * parent) :
   sizer->AddGrowableCol(1, 1);
 }
 
-GDBStackPanel::GDBStackPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY), stack_global(NULL), stack_size(0), stack_top(0) {
+void GDBAssemblyPanel::SetAssemblyCode(wxString value) {
+  long first_line;
+  long end_line;
+  update_text(assemblyCodeText, value, first_line, end_line);
+
+  // Only the lines rewritten lost their colours; there are a window's worth
+  // at most, so they are lexed right away
+  std::string code(value.utf8_str());
+  size_t begin = 0;
+  for (long line = 0; line < end_line && begin < code.size(); line++) {
+    size_t end = std::min(code.find('\n', begin), code.size());
+    if (line >= first_line) {
+      std::vector<SyntaxSpan> spans;
+      syntax_lex_assembly_line(code.data() + begin, end - begin, spans);
+      long start = assemblyCodeText->XYToPosition(0, line);
+      assemblyCodeText->SetStyle(start, start + assemblyCodeText->GetLineLength(line), 
+          wxTextAttr(*wxBLACK));
+      for (size_t i = 0; i < spans.size(); i++) {
+        // Disassembly is ASCII, so bytes are characters
+        assemblyCodeText->SetStyle(start + spans[i].begin, start + spans[i].begin + spans[i].length,
+            wxTextAttr(syntax_colour(spans[i].kind)));
+      }
+    }
+    begin = end + 1;
+  }
+}
+
+void GDBAssemblyPanel::SetRegisterTable(std::vector<GDBRegister> * registers) {
+  bool same_registers = registers->size() == shownRegisters.size();
+  for (size_t row = 0; same_registers && row < registers->size(); row++) {
+    same_registers = (*registers)[row].number == shownRegisters[row].number;
+  }
+
+  // Stepping changes a handful of registers, so only their rows are rewritten
+  if (!same_registers) {
+    std::string text;
+    for (size_t row = 0; row < registers->size(); row++) {
+      text.append(format_register((*registers)[row])).append("\n");
+    }
+    registersText->SetValue(registers->empty() ? wxString(GDB_NO_REGISTERS) : wxString(text));
+    shownRegisters.assign(registers->size(), GDBRegister());
+  }
+  for (size_t row = 0; row < registers->size(); row++) {
+    const GDBRegister & reg = (*registers)[row];
+    GDBRegister & shown = shownRegisters[row];
+    long start = registersText->XYToPosition(0, row);
+    long end = start + registersText->GetLineLength(row);
+    if (same_registers && (reg.raw != shown.raw || reg.natural != shown.natural)) {
+      registersText->Replace(start, end, format_register(reg));
+      end = start + registersText->GetLineLength(row);
+    }
+    if (reg.changed || shown.changed) {
+      registersText->SetStyle(start, end, wxTextAttr(reg.changed ? *wxRED : *wxBLACK));
+    }
+    shown = reg;
+  }
+
+  delete registers;
+}
+
+void GDBAssemblyPanel::OnRegisterGroupToggled(wxCollapsiblePaneEvent & event) {
+  int group = event.GetId() - GG_ID_REGISTER_GROUP;
+  request_register_group((GDBRegisterGroup) group, !event.GetCollapsed());
+  Layout();
+}
+
+void GDBAssemblyPanel::OnAssemblyWheel(wxMouseEvent & event) {
+  // Wheel rotation is positive away from the user, i.e. up
+  long notches = event.GetWheelRotation() / std::max(event.GetWheelDelta(), 1);
+  if (notches) {
+    request_assembly_scroll(-notches * GG_ASSEMBLY_SCROLL_LINES);
+  }
+}
+
+GDBStackTable::GDBStackTable() : rows(0), stack_pointer(0), frame_pointer(0) {
+  garbage_attr = new wxGridCellAttr();
+  garbage_attr->SetBackgroundColour(wxColour(200, 200, 200));
+  stack_pointer_attr = new wxGridCellAttr();
+  stack_pointer_attr->SetBackgroundColour(wxColour(255, 255, 124));
+  frame_pointer_attr = new wxGridCellAttr();
+  frame_pointer_attr->SetBackgroundColour(wxColour(182, 149, 192));
+  changed_attr = new wxGridCellAttr();
+  changed_attr->SetTextColour(*wxRED);
+  changed_garbage_attr = new wxGridCellAttr();
+  changed_garbage_attr->SetBackgroundColour(wxColour(200, 200, 200));
+  changed_garbage_attr->SetTextColour(*wxRED);
+}
+
+GDBStackTable::~GDBStackTable() {
+  garbage_attr->DecRef();
+  stack_pointer_attr->DecRef();
+  frame_pointer_attr->DecRef();
+  changed_attr->DecRef();
+  changed_garbage_attr->DecRef();
+}
+
+void GDBStackTable::SetStack(const std::map<long, GDBStackPage> & pages, 
+    long stack_pointer, long frame_pointer)
+{
+  this->stack_pointer = stack_pointer;
+  this->frame_pointer = frame_pointer;
+
+  // Each row has 4 columns of memory values
+  long old_rows = rows;
+  rows = 0;
+  page_rows.clear();
+  for (std::map<long, GDBStackPage>::const_iterator page = pages.begin(); 
+      page != pages.end(); page++) {
+    PageRows entry = { rows, page->first, &page->second };
+    page_rows.push_back(entry);
+    rows += (page->second.known_end - page->second.known_begin + 3) / 4;
+  }
+
+  // The grid only learns about rows through messages
+  wxGrid * grid = GetView();
+  if (!grid) {
+    return;
+  }
+  if (rows < old_rows) {
+    wxGridTableMessage deleted(this, wxGRIDTABLE_NOTIFY_ROWS_DELETED, rows, old_rows - rows);
+    grid->ProcessTableMessage(deleted);
+  }
+  else if (rows > old_rows) {
+    wxGridTableMessage appended(this, wxGRIDTABLE_NOTIFY_ROWS_APPENDED, rows - old_rows);
+    grid->ProcessTableMessage(appended);
+  }
+  grid->ForceRefresh();
+}
+
+const GDBStackTable::PageRows * GDBStackTable::FindRow(int row, long & address) const {
+  if (row < 0 || row >= rows) {
+    return nullptr;
+  }
+
+  // The last page starting at or before the row
+  size_t low = 0;
+  size_t high = page_rows.size();
+  while (high - low > 1) {
+    size_t middle = (low + high) / 2;
+    if (page_rows[middle].first_row <= row) {
+      low = middle;
+    }
+    else {
+      high = middle;
+    }
+  }
+  const PageRows & entry = page_rows[low];
+  address = entry.address + entry.page->known_begin + (row - entry.first_row) * 4;
+  return &entry;
+}
+
+wxString GDBStackTable::GetValue(int row, int col) {
+  long address;
+  const PageRows * entry = FindRow(row, address);
+  if (!entry) {
+    return wxEmptyString;
+  }
+  if (col == 0) {
+    return long_to_string(address, 1);
+  }
+
+  // The last row of a page may be short
+  long offset = address - entry->address + col - 1;
+  if (offset >= entry->page->known_end) {
+    return wxEmptyString;
+  }
+  return long_to_string(entry->page->bytes[offset], 1);
+}
+
+wxString GDBStackTable::GetColLabelValue(int col) {
+  if (col == 0) {
+    return "Address\t\t";
+  }
+  return wxString::Format("Address[%d]\t\t", col - 1);
+}
+
+wxString GDBStackTable::GetRowLabelValue(int row) {
+  long address;
+  if (!FindRow(row, address)) {
+    return wxEmptyString;
+  }
+
+  // Rows above the stack pointer shouldn't be accessed via the frame pointer
+  if (address < stack_pointer) {
+    return "n/a";
+  }
+  return long_to_string(address - frame_pointer, 0);
+}
+
+wxGridCellAttr * GDBStackTable::GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind) {
+  long address;
+  const PageRows * entry = FindRow(row, address);
+  if (!entry) {
+    return nullptr;
+  }
+
+  // Bytes changed since the last stop are shown in red
+  long offset = address - entry->address + col - 1;
+  bool changed = col > 0 && offset < entry->page->known_end && 
+    !entry->page->changed.empty() && entry->page->changed[offset];
+
+  // Highlight the stack and frame pointers, and grey out memory above the
+  // stack pointer; this is garbage space
+  wxGridCellAttr * attr = nullptr;
+  if (changed) {
+    attr = address < stack_pointer ? changed_garbage_attr : changed_attr;
+  }
+  else if (col == 0 && address == stack_pointer) {
+    attr = stack_pointer_attr;
+  }
+  else if (col == 0 && address == frame_pointer) {
+    attr = frame_pointer_attr;
+  }
+  else if (address < stack_pointer) {
+    attr = garbage_attr;
+  }
+  if (attr) {
+    attr->IncRef();
+  }
+  return attr;
+}
+
+GDBStackPanel::GDBStackPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY), stack_frames(0) {
+  // Memory kept for stacks seen before can be capped from the environment
+  const char * cache_kb = getenv(GG_STACK_CACHE_ENV);
+  long max_kb = cache_kb ? atol(cache_kb) : GG_STACK_CACHE_KB;
+  stack_max_pages = std::max(max_kb * 1024 / GG_STACK_PAGE_SIZE, 1L);
+
   // A simple box sizer should suffice
   wxBoxSizer * sizer = new wxBoxSizer(wxHORIZONTAL);
   SetSizer(sizer);
 
-  // Create the grid object and the five columns that go with it
+  // Create the grid object, whose five columns come from the table
   grid = new wxGrid(this, wxID_ANY, wxDefaultPosition, wxDefaultSize);
-  grid->CreateGrid(0, 5);
-
-  // Set the titles for each column
-  grid->SetColLabelValue(0, "Address\t\t");
-  grid->SetColLabelValue(1, "Address[0]\t\t");
-  grid->SetColLabelValue(2, "Address[1]\t\t");
-  grid->SetColLabelValue(3, "Address[2]\t\t");
-  grid->SetColLabelValue(4, "Address[3]\t\t");
+  table = new GDBStackTable();
+  grid->SetTable(table, true);
 
   // Disable editing & resize grid to fit labels
   grid->AutoSize();
@@ -198,139 +787,296 @@ GDBStackPanel::GDBStackPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY), sta
   sizer->Add(grid, 1, wxEXPAND | wxALL, 5);
 }
 
-GDBStackPanel::~GDBStackPanel() {
-  // The destructor just needs to clean up the global stack if it exists.
-  if (stack_global) {
-    delete stack_global;
+void GDBStackPanel::MergeStackPage(GDBStackPage & page, long offset, long length, 
+    const uint8_t * fetched)
+{
+  // A page fetched over the same range as before is most often unchanged,
+  // which its hash tells without comparing any bytes
+  uint64_t hash = hash_bytes(fetched, length);
+  bool same_range = offset == page.known_begin && offset + length == page.known_end;
+  if (same_range && hash == page.hash) {
+    return;
   }
-}
 
-void GDBStackPanel::SetStackFrame(StackFrame * stack_frame) {
-  // Delete old rows from the grid
-  if (grid->GetNumberRows()) {
-    grid->DeleteRows(0, grid->GetNumberRows());
+  // Only the bytes known before can have changed
+  long overlap_begin = std::max(offset, page.known_begin);
+  long overlap_end = std::min(offset + length, page.known_end);
+  if (overlap_begin < overlap_end) {
+    page.changed.assign(GG_STACK_PAGE_SIZE, 0);
+    if (!diff_bytes(page.bytes.data() + overlap_begin, fetched + (overlap_begin - offset), 
+          overlap_end - overlap_begin, page.changed.data() + overlap_begin)) {
+      page.changed.clear();
+    }
   }
 
-  if (!stack_frame || !stack_frame->memory) {
+  memcpy(page.bytes.data() + offset, fetched, length);
+  page.known_begin = std::min(page.known_begin, offset);
+  page.known_end = std::max(page.known_end, offset + length);
+  page.hash = same_range ? hash : 
+    hash_bytes(page.bytes.data() + page.known_begin, page.known_end - page.known_begin);
+}
+
+void GDBStackPanel::SetStackFrame(std::unique_ptr<StackFrame> stack_frame) {
+  if (!stack_frame || stack_frame->memory.empty()) {
     // Clear the global stack if given an empty stack frame
-    if (stack_global) {
-      delete stack_global;
-      stack_global = nullptr;
-      stack_size = 0;
-      stack_top = 0;
-    }
+    stack_pages.clear();
+    stack_lru.clear();
+    changed_pages.clear();
+    table->SetStack(stack_pages, 0, 0);
+    return;
   }
-  else {
-    if (stack_global) {
-      // Determine the border addresses of the full stack & of the stack frame
-      long stack_frame_top = stack_frame->stack_pointer; 
-      long stack_frame_bottom = stack_frame->stack_pointer + stack_frame->memory_length; 
-      long stack_bottom = stack_top + stack_size;
-
-      // Determine the border addresses of the combined stack
-      long new_stack_top = stack_frame_top < stack_top ? stack_frame_top : stack_top; 
-      long new_stack_bottom = stack_frame_bottom > stack_bottom ? stack_frame_bottom : stack_bottom;
-      long new_stack_size = new_stack_bottom - new_stack_top;
-
-      // Create the new, combined stack as a list of long values (representing bytes)
-      long * new_stack;
-      int free_old_stack;
-
-      // If the stack border addresses haven't changed, we can reuse the old stack array and avoid malloc'ing a new one
-      if (new_stack_top == stack_top && new_stack_bottom == stack_bottom) {
-        new_stack = stack_global;
-        free_old_stack = 0;
-      }
-      else {
-        new_stack = (long *) malloc(new_stack_size * sizeof(long));
-        free_old_stack = 1;
-      }
-      
-      // Copy the values of the stack frame and the old stack into the new stack
-      for (int index = 0; index < new_stack_size; index++) {
-        long address = new_stack_top + index;
-
-        // The stack frame takes precedence, since it represents the most recently known values
-        if (address >= stack_frame_top && address < stack_frame_bottom) {
-          new_stack[index] = stack_frame->memory[address - stack_frame_top];
-        }
-        // The old stack is then used to fill the new stack's values 
-        else if (address >= stack_top && address < stack_bottom) {
-          new_stack[index] = stack_global[address - stack_top];
-        }
-        // Any unknown addresses are filled with 0's
-        else {
-          new_stack[index] = 0;
-        }
-      }
 
-      // If we created a new stack, we need to delete the old stack to prevent memory leaks
-      if (free_old_stack) {
-        delete stack_global;
-      }
+  // Only bytes changed by this frame are highlighted
+  for (size_t index = 0; index < changed_pages.size(); index++) {
+    std::map<long, GDBStackPage>::iterator page = stack_pages.find(changed_pages[index]);
+    if (page != stack_pages.end()) {
+      page->second.changed.clear();
+    }
+  }
+  changed_pages.clear();
 
-      // Replace the stack values
-      stack_global = new_stack;
-      stack_size = new_stack_size;
-      stack_top = new_stack_top;
+  // Copy the frame into the pages it covers; the stack frame takes 
+  // precedence, since it represents the most recently known values
+  stack_frames++;
+  long stack_frame_top = stack_frame->stack_pointer; 
+  long stack_frame_bottom = stack_frame->stack_pointer + stack_frame->memory.size(); 
+  for (long address = stack_frame_top; address < stack_frame_bottom;) {
+    long offset = address % GG_STACK_PAGE_SIZE;
+    long length = std::min(GG_STACK_PAGE_SIZE - offset, stack_frame_bottom - address);
+    std::map<long, GDBStackPage>::iterator page = stack_pages.find(address - offset);
+    const uint8_t * fetched = stack_frame->memory.data() + (address - stack_frame_top);
+    if (page == stack_pages.end()) {
+      // Unknown addresses are filled with 0's
+      page = stack_pages.insert(std::make_pair(address - offset, GDBStackPage())).first;
+      page->second.bytes.assign(GG_STACK_PAGE_SIZE, 0);
+      page->second.known_begin = offset;
+      page->second.known_end = offset + length;
+      stack_lru.push_front(page->first);
+      page->second.lru_entry = stack_lru.begin();
+      memcpy(page->second.bytes.data() + offset, fetched, length);
+      page->second.hash = hash_bytes(fetched, length);
     }
     else {
-      // Since the stack doesn't exist, we need to allocate memory for it
-      stack_global = (long *) malloc(stack_frame->memory_length * sizeof(long));
-      stack_size = stack_frame->memory_length;
-      stack_top = stack_frame->stack_pointer;
+      stack_lru.splice(stack_lru.begin(), stack_lru, page->second.lru_entry);
+      MergeStackPage(page->second, offset, length, fetched);
+      if (!page->second.changed.empty()) {
+        changed_pages.push_back(page->first);
+      }
+    }
+    page->second.last_seen = stack_frames;
+    address += length;
+  }
 
-      // The stack frame is the entire stack, so we copy the frame's values into the global stack 
-      memcpy(stack_global, stack_frame->memory, stack_frame->memory_length * sizeof(long));
+  // Drop the pages seen longest ago, never those of this frame
+  while (stack_pages.size() > stack_max_pages && 
+      stack_pages[stack_lru.back()].last_seen != stack_frames) {
+    stack_pages.erase(stack_lru.back());
+    stack_lru.pop_back();
+  }
+
+  // Only the rows drawn are ever formatted
+  table->SetStack(stack_pages, stack_frame->stack_pointer, stack_frame->frame_pointer);
+}
+
+GDBMemoryTable::GDBMemoryTable() : begin(0), length(0), rows(0) {
+  changed_attr = new wxGridCellAttr();
+  changed_attr->SetTextColour(*wxRED);
+}
+
+GDBMemoryTable::~GDBMemoryTable() {
+  changed_attr->DecRef();
+}
+
+void GDBMemoryTable::SetRange(unsigned long begin, unsigned long length) {
+  this->begin = begin;
+  this->length = length;
+
+  long old_rows = rows;
+  rows = (length + GG_MEMORY_ROW_BYTES - 1) / GG_MEMORY_ROW_BYTES;
+
+  // The grid only learns about rows through messages
+  wxGrid * grid = GetView();
+  if (!grid) {
+    return;
+  }
+  if (rows < old_rows) {
+    wxGridTableMessage deleted(this, wxGRIDTABLE_NOTIFY_ROWS_DELETED, rows, old_rows - rows);
+    grid->ProcessTableMessage(deleted);
+  }
+  else if (rows > old_rows) {
+    wxGridTableMessage appended(this, wxGRIDTABLE_NOTIFY_ROWS_APPENDED, rows - old_rows);
+    grid->ProcessTableMessage(appended);
+  }
+  grid->ForceRefresh();
+}
+
+void GDBMemoryTable::SetPage(std::unique_ptr<GDBMemoryPage> page) {
+  requested.erase(page->address);
+  CachedPage & cached = pages[page->address];
+  cached.bytes.swap(page->bytes);
+  cached.hash = hash_bytes(cached.bytes.data(), cached.bytes.size());
+  cached.changed.clear();
+
+  // Bytes are only compared when the page hashes differently than before
+  std::unordered_map<unsigned long, CachedPage>::const_iterator previous = 
+    previous_pages.find(page->address);
+  if (previous != previous_pages.end() && previous->second.hash != cached.hash &&
+      previous->second.bytes.size() == cached.bytes.size() && !cached.bytes.empty()) {
+    cached.changed.resize(cached.bytes.size());
+    if (!diff_bytes(previous->second.bytes.data(), cached.bytes.data(), cached.bytes.size(), 
+          cached.changed.data())) {
+      cached.changed.clear();
     }
+  }
+  if (GetView()) {
+    GetView()->ForceRefresh();
+  }
+}
 
-    // Each row has 4 columns of memory values
-    grid->AppendRows(stack_size / 4);
-
-    // Loop through each value on the stack
-    for (int index = 0; index < stack_size; index++) {
-      long value = stack_global[index];
-      long address = stack_top + index;
-      long row =  index / 4;
-      long col = index % 4;
-
-      // Set the row address & frame pointer offset
-      if (col == 0) {
-        grid->SetCellValue(row, 0, long_to_string(stack_top + index, 1)); 
-
-        // Switch row identification based on its location relative to the stack pointer
-        if (address < stack_frame->stack_pointer) {
-          // Rows above the stack pointer shouldn't be accessed via the frame pointer
-          grid->SetRowLabelValue(row, "n/a");
-
-          // Grey out memory above the stack pointer; this is garbage space
-          for (long col2 = 0; col2 < 5; col2++) {
-            grid->SetCellBackgroundColour(row, col2, wxColour(200, 200, 200));
-          }
-        }
-        else {
-          grid->SetRowLabelValue(row, long_to_string(address - stack_frame->frame_pointer, 0)); 
-        }
-
-        // Highlight the stack pointer
-        if (address == stack_frame->stack_pointer) {
-          grid->SetCellBackgroundColour(row, 0, wxColour(255, 255, 124));
-        }
-        else if (address == stack_frame->frame_pointer) {
-          grid->SetCellBackgroundColour(row, 0, wxColour(182, 149, 192));
-        }
-      }
+void GDBMemoryTable::ClearPages() {
+  // Pages are kept until they are read again, to find what changed
+  previous_pages.swap(pages);
+  pages.clear();
+  requested.clear();
+  if (GetView()) {
+    GetView()->ForceRefresh();
+  }
+}
+
+const GDBMemoryTable::CachedPage * GDBMemoryTable::FindPage(unsigned long address) {
+  unsigned long page_address = address - address % GG_MEMORY_PAGE_SIZE;
+  std::unordered_map<unsigned long, CachedPage>::const_iterator page = 
+    pages.find(page_address);
+  if (page != pages.end()) {
+    return &page->second;
+  }
 
-      // Set the cell value to be the stack value
-      grid->SetCellValue(row, col + 1, long_to_string(value, 1));
+  // Scrolling on is likely, so the next page is read along with this one
+  for (unsigned long next = page_address; next <= page_address + GG_MEMORY_PAGE_SIZE &&
+      next < begin + length; next += GG_MEMORY_PAGE_SIZE) {
+    if (!pages.count(next) && requested.insert(next).second) {
+      request_memory_page(next);
     }
   }
+  return nullptr;
+}
 
-  // Delete the stack frame and any memory associated with it
-  if (stack_frame) {
-    if (stack_frame->memory) {
-      delete stack_frame->memory;
+wxString GDBMemoryTable::GetValue(int row, int col) {
+  if (row < 0 || row >= rows) {
+    return wxEmptyString;
+  }
+  unsigned long address = begin + (unsigned long) row * GG_MEMORY_ROW_BYTES;
+  if (col == 0) {
+    return long_to_string(address, 1);
+  }
+
+  // Each byte has its own column, so those that changed can be coloured
+  if (col <= GG_MEMORY_ROW_BYTES) {
+    unsigned long byte = address + col - 1;
+    if (byte >= begin + length) {
+      return wxEmptyString;
+    }
+    const CachedPage * page = FindPage(byte);
+    if (!page || page->bytes.empty()) {
+      return wxString("??");
     }
-    delete stack_frame;
+    char text[3];
+    snprintf(text, sizeof(text), "%02x", page->bytes[byte % GG_MEMORY_PAGE_SIZE]);
+    return wxString(text);
   }
+
+  // Rows may straddle pages when the range doesn't start on one
+  char text[GG_MEMORY_ROW_BYTES + 1];
+  size_t used = 0;
+  for (unsigned long byte = address; byte < address + GG_MEMORY_ROW_BYTES && 
+      byte < begin + length; byte++) {
+    const CachedPage * page = FindPage(byte);
+    bool known = page && !page->bytes.empty();
+    uint8_t value = known ? page->bytes[byte % GG_MEMORY_PAGE_SIZE] : 0;
+    text[used++] = known && value >= 0x20 && value < 0x7f ? (char) value : '.';
+  }
+  text[used] = '\0';
+  return wxString(text);
+}
+
+wxString GDBMemoryTable::GetColLabelValue(int col) {
+  if (col == 0) {
+    return wxString("Address");
+  }
+  if (col > GG_MEMORY_ROW_BYTES) {
+    return wxString("ASCII");
+  }
+  char label[8];
+  snprintf(label, sizeof(label), "+%x", col - 1);
+  return wxString(label);
+}
+
+wxGridCellAttr * GDBMemoryTable::GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind) {
+  if (row < 0 || row >= rows || col < 1 || col > GG_MEMORY_ROW_BYTES) {
+    return nullptr;
+  }
+  unsigned long byte = begin + (unsigned long) row * GG_MEMORY_ROW_BYTES + col - 1;
+  std::unordered_map<unsigned long, CachedPage>::const_iterator page = 
+    pages.find(byte - byte % GG_MEMORY_PAGE_SIZE);
+  if (byte >= begin + length || page == pages.end() || page->second.changed.empty() ||
+      !page->second.changed[byte % GG_MEMORY_PAGE_SIZE]) {
+    return nullptr;
+  }
+  changed_attr->IncRef();
+  return changed_attr;
+}
+
+GDBMemoryPanel::GDBMemoryPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY) {
+  wxBoxSizer * sizer = new wxBoxSizer(wxVERTICAL);
+  SetSizer(sizer);
+
+  // Create the fields choosing what is shown
+  wxBoxSizer * fieldsSizer = new wxBoxSizer(wxHORIZONTAL);
+  addressText = new wxTextCtrl(this, wxID_ANY, wxEmptyString, 
+      wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
+  lengthText = new wxTextCtrl(this, wxID_ANY, GG_MEMORY_DEFAULT_LENGTH, 
+      wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
+  fieldsSizer->Add(new wxStaticText(this, wxID_ANY, "Address"), 0, 
+      wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  fieldsSizer->Add(addressText, 1, wxALL, 5);
+  fieldsSizer->Add(new wxStaticText(this, wxID_ANY, "Length"), 0, 
+      wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  fieldsSizer->Add(lengthText, 0, wxALL, 5);
+  sizer->Add(fieldsSizer, 0, wxEXPAND);
+  addressText->Bind(wxEVT_TEXT_ENTER, &GDBMemoryPanel::OnMemoryViewEntered, this);
+  lengthText->Bind(wxEVT_TEXT_ENTER, &GDBMemoryPanel::OnMemoryViewEntered, this);
+
+  // Create the grid, whose rows come from the table as they are drawn
+  grid = new wxGrid(this, wxID_ANY, wxDefaultPosition, wxDefaultSize);
+  table = new GDBMemoryTable();
+  grid->SetTable(table, true);
+  grid->SetDefaultCellFont(wxFont(10, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+  grid->EnableEditing(false);
+  grid->AutoSize();
+  grid->SetDefaultColSize(3 * grid->GetCharWidth());
+  grid->SetColSize(0, 18 * grid->GetCharWidth());
+  grid->SetColSize(GG_MEMORY_ROW_BYTES + 1, (GG_MEMORY_ROW_BYTES + 2) * grid->GetCharWidth());
+  sizer->Add(grid, 1, wxEXPAND | wxALL, 5);
+}
+
+void GDBMemoryPanel::SetMemoryView(bool found, unsigned long address) {
+  unsigned long length = 0;
+  if (found && !lengthText->GetValue().ToULong(&length, 0)) {
+    length = 0;
+  }
+  table->ClearPages();
+  table->SetRange(address, std::min(length, GG_MEMORY_MAX_LENGTH));
+}
+
+void GDBMemoryPanel::SetMemoryPage(std::unique_ptr<GDBMemoryPage> page) {
+  if (page) {
+    table->SetPage(std::move(page));
+  }
+  else {
+    table->ClearPages();
+  }
+}
+
+void GDBMemoryPanel::OnMemoryViewEntered(wxCommandEvent & event) {
+  request_memory_view(addressText->GetValue().ToStdString());
 }
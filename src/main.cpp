@@ -1,8 +1,14 @@
+#include <atomic>
+#include <mutex>
+#include <sstream>
 #include <thread>
 
 #include <readline/readline.h>
 #include <readline/history.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "gg.hpp" 
 
@@ -17,15 +23,28 @@ wxBEGIN_EVENT_TABLE(GDBFrame, wxFrame)
   EVT_COMMAND(wxID_ANY, GDB_EVT_ASSEMBLY_CODE_UPDATE, GDBFrame::DoAssemblyCodeUpdate)
   EVT_COMMAND(wxID_ANY, GDB_EVT_REGISTERS_UPDATE, GDBFrame::DoRegistersUpdate)
   EVT_COMMAND(wxID_ANY, GDB_EVT_STACK_FRAME_UPDATE, GDBFrame::DoStackFrameUpdate) 
+  EVT_COMMAND(wxID_ANY, GDB_EVT_REGISTER_GROUP_UPDATE, GDBFrame::DoRegisterGroupUpdate)
+  EVT_COMMAND(wxID_ANY, GDB_EVT_MEMORY_VIEW_UPDATE, GDBFrame::DoMemoryViewUpdate)
+  EVT_COMMAND(wxID_ANY, GDB_EVT_MEMORY_UPDATE, GDBFrame::DoMemoryUpdate)
 wxEND_EVENT_TABLE()
 
 // Macro to tell wxWidgets to use our GDB GUI application.
 wxIMPLEMENT_APP_NO_MAIN(GDBApp);
 
-void update_console_and_gui(GDB & gdb) {
-  // Read from GDB to populate buffer
-  gdb.read_until_prompt(std::cout, std::cerr, true);
+// Queues updates for the groups of registers that have text.
+void queue_register_groups(wxEvtHandler * handler, const std::string * register_groups) {
+  for (int group = 0; group < GDB_GROUP_COUNT; group++) {
+    if (!register_groups[group].empty()) {
+      wxCommandEvent * register_group_update = 
+        new wxCommandEvent(GDB_EVT_REGISTER_GROUP_UPDATE);
+      register_group_update->SetInt(group);
+      register_group_update->SetString(register_groups[group]);
+      handler->QueueEvent(register_group_update);
+    }
+  }
+}
 
+void update_gui(GDB & gdb) {
   // Queue events if gdb is alive and 
   // application has been initialized on separate thread
   if (gdb.is_alive() && wxTheApp) { // App will be null if wxEntry() hasn't been called
@@ -33,15 +52,8 @@ void update_console_and_gui(GDB & gdb) {
     if (window) { // Window will be null if GDBApp::OnInit() hasn't been called
       wxEvtHandler * handler = window->GetEventHandler();
 
-      // Update displays if we detect line numbers have changed
-      long line_number = gdb.is_running_program() ?
-        gdb.get_source_line_number() : 0;
-      long saved_line_number = gdb.get_saved_line_number();
-
-      // Set saved line number to be current line number
-      gdb.set_saved_line_number(line_number);
-
-      if (line_number != saved_line_number) {
+      // Update displays only if the program stopped, started, exited or moved
+      if (gdb.needs_refresh()) {
         // Create event objects
         wxCommandEvent * status_bar_update =  
           new wxCommandEvent(GDB_EVT_STATUS_BAR_UPDATE);
@@ -58,14 +70,19 @@ void update_console_and_gui(GDB & gdb) {
         wxCommandEvent * stack_frame_update =
           new wxCommandEvent(GDB_EVT_STACK_FRAME_UPDATE);
 
-        // Set contents of events
-        status_bar_update->SetString(gdb.is_running_program() ? GDB_STATUS_RUNNING : GDB_STATUS_IDLE);
-        source_code_update->SetString(gdb.get_source_code());
-        locals_update->SetString(gdb.get_local_variables());
-        params_update->SetString(gdb.get_formal_parameters());
-        assembly_code_update->SetString(gdb.get_assembly_code());
-        registers_update->SetString(gdb.get_registers());
-        stack_frame_update->SetClientData(gdb.get_stack_frame());
+        // Gather everything at once and set contents of events
+        GDBRefresh refresh;
+        gdb.refresh(refresh);
+        status_bar_update->SetString(refresh.status);
+        source_code_update->SetString(refresh.source_code);
+        source_code_update->SetClientData(refresh.source_position.release());
+        locals_update->SetString(refresh.local_variables);
+        params_update->SetString(refresh.formal_parameters);
+        assembly_code_update->SetString(refresh.assembly_code);
+        registers_update->SetString(refresh.registers);
+        registers_update->SetClientData(refresh.register_table.empty() ? nullptr :
+          new std::vector<GDBRegister>(refresh.register_table));
+        stack_frame_update->SetClientData(refresh.stack_frame.release());
 
         // Send events to GUI application
         handler->QueueEvent(status_bar_update);
@@ -75,81 +92,298 @@ void update_console_and_gui(GDB & gdb) {
         handler->QueueEvent(assembly_code_update);
         handler->QueueEvent(registers_update);
         handler->QueueEvent(stack_frame_update);
+
+        // Groups of registers are only there while shown
+        queue_register_groups(handler, refresh.register_groups);
+
+        // Memory read before may have changed since
+        handler->QueueEvent(new wxCommandEvent(GDB_EVT_MEMORY_UPDATE));
+      }
+    }
+  }
+}
+
+void update_console_and_gui(GDB & gdb) {
+  // Read from GDB to populate buffer
+  gdb.read_until_prompt(std::cout, std::cerr, true);
+
+  update_gui(gdb);
+}
+
+// The GDB the console is attached to, for readline's line handler.
+static GDB * console_gdb = nullptr;
+
+// Keep track of last command executed 
+static const char * last_command = nullptr; 
+
+// Set once the user has closed the console's input
+static bool console_closed = false;
+
+// Pipe the GUI writes to when it needs something from GDB, along with what 
+// it needs: the lines the assembly display was scrolled by, a bit for 
+// each group of registers shown, and where memory should be shown from
+// and the pages of it to read
+static int gui_request_event[2] = { -1, -1 };
+static std::atomic<long> assembly_scroll_lines(0);
+static std::atomic<int> register_groups_shown(0);
+static std::mutex memory_requests_lock;
+static std::vector<std::string> memory_view_requests;
+static std::vector<unsigned long> memory_page_requests;
+
+// Groups of registers GDB was last told were shown
+static int register_groups_fetched = 0;
+
+// Wakes up the console thread to handle what the GUI asked for. A full 
+// pipe already holds a wake-up, so failing to write is fine.
+static void wake_console() {
+  char byte = 0;
+  ssize_t written = write(gui_request_event[1], &byte, 1);
+  (void) written;
+}
+
+void request_assembly_scroll(long lines) {
+  assembly_scroll_lines += lines;
+  wake_console();
+}
+
+void request_register_group(GDBRegisterGroup group, bool shown) {
+  if (shown) {
+    register_groups_shown |= 1 << group;
+  }
+  else {
+    register_groups_shown &= ~(1 << group);
+  }
+  wake_console();
+}
+
+void request_memory_view(const std::string & expression) {
+  {
+    std::lock_guard<std::mutex> lock(memory_requests_lock);
+    memory_view_requests.push_back(expression);
+  }
+  wake_console();
+}
+
+void request_memory_page(unsigned long address) {
+  {
+    std::lock_guard<std::mutex> lock(memory_requests_lock);
+    memory_page_requests.push_back(address);
+  }
+  wake_console();
+}
+
+// Finds where memory should be shown from and reads the pages of it that
+// scrolled into view.
+void read_requested_memory(GDB & gdb, wxEvtHandler * handler) {
+  std::vector<std::string> expressions;
+  std::vector<unsigned long> addresses;
+  {
+    std::lock_guard<std::mutex> lock(memory_requests_lock);
+    expressions.swap(memory_view_requests);
+    addresses.swap(memory_page_requests);
+  }
+
+  for (size_t i = 0; i < expressions.size(); i++) {
+    unsigned long address = 0;
+    bool found = gdb.is_running_program() && 
+      gdb.evaluate_address(expressions[i].c_str(), address);
+    wxCommandEvent * memory_view_update = 
+      new wxCommandEvent(GDB_EVT_MEMORY_VIEW_UPDATE);
+    memory_view_update->SetInt(found);
+    memory_view_update->SetExtraLong((long) address);
+    memory_view_update->SetString(expressions[i]);
+    handler->QueueEvent(memory_view_update);
+  }
+
+  for (size_t i = 0; i < addresses.size(); i++) {
+    // Pages that can't be read are sent empty so they aren't asked again
+    std::unique_ptr<GDBMemoryPage> page(new GDBMemoryPage());
+    page->address = addresses[i];
+    MIMemory memory;
+    if (gdb.is_running_program() && 
+        gdb.read_memory(addresses[i], GG_MEMORY_PAGE_SIZE, memory) &&
+        memory.contents.size() == GG_MEMORY_PAGE_SIZE) {
+      page->bytes.swap(memory.contents);
+    }
+    wxCommandEvent * memory_update = new wxCommandEvent(GDB_EVT_MEMORY_UPDATE);
+    memory_update->SetClientData(page.release());
+    handler->QueueEvent(memory_update);
+  }
+}
+
+// Handles what the GUI asked for: moves the assembly display by whatever 
+// the user scrolled, disassembling more on the way if needed, fetches
+// groups of registers the user just expanded, and reads memory.
+void handle_gui_requests(GDB & gdb) {
+  char drained[64];
+  while (read(gui_request_event[0], drained, sizeof(drained)) > 0);
+
+  wxWindow * window = wxTheApp ? wxTheApp->GetTopWindow() : nullptr;
+  if (!window) {
+    return;
+  }
+  wxEvtHandler * handler = window->GetEventHandler();
+
+  long lines = assembly_scroll_lines.exchange(0);
+  std::string assembly_code;
+  if (lines && gdb.scroll_assembly(lines, assembly_code)) {
+    wxCommandEvent * assembly_code_update = 
+      new wxCommandEvent(GDB_EVT_ASSEMBLY_CODE_UPDATE);
+    assembly_code_update->SetString(assembly_code);
+    handler->QueueEvent(assembly_code_update);
+  }
+
+  int shown = register_groups_shown.load();
+  std::string register_groups[GDB_GROUP_COUNT];
+  for (int group = 0; group < GDB_GROUP_COUNT; group++) {
+    bool group_shown = shown & 1 << group;
+    if (group_shown != (bool) (register_groups_fetched & 1 << group)) {
+      gdb.set_register_group_expanded((GDBRegisterGroup) group, group_shown);
+      if (group_shown) {
+        register_groups[group] = gdb.get_register_group((GDBRegisterGroup) group);
       }
     }
   }
+  register_groups_fetched = shown;
+  queue_register_groups(handler, register_groups);
+
+  read_requested_memory(gdb, handler);
+}
+
+// Executes a line once readline has read it in full.
+void execute_line(char * line) {
+  GDB & gdb = *console_gdb;
+  const char * command = line;
+  bool command_deletion = true;
+
+  // A null pointer signals EOF and GDB should execute quit 
+  if (!command) {
+    // Print quit command
+    std::cout << GDB_QUIT << std::endl;
+
+    // Specify that the quit command should be executed
+    command = GDB_QUIT; 
+
+    // Do not delete the "quit" literal
+    command_deletion = false;
+
+    // There will be no more lines to read
+    console_closed = true;
+  }
+
+  // GDB handles empty commands by executing the previous command  
+  if (!strlen(command)) {
+    if (!last_command) {
+      return;
+    }
+    else {
+      command = last_command;
+      command_deletion = false;
+    }
+  }
+
+  // Execute the command and display result
+  gdb.execute(command);
+  update_console_and_gui(gdb);
+
+  // Add the command to history if user executed something different previously
+  if (!last_command || strcmp(command, last_command)) {
+    add_history(command);
+  }
+
+  // The current command becomes last command executed 
+  if (command_deletion) {
+    delete last_command;
+    last_command = command;
+  }
+
+  // Don't prompt for more once GDB or the input is gone
+  if (!gdb.is_alive() || console_closed) {
+    rl_callback_handler_remove();
+  }
+}
+
+// Shows output GDB wrote on its own (e.g. a running inferior printing)
+// above the line the user is typing, then puts the line back.
+void print_available_output(GDB & gdb) {
+  std::ostringstream output, error;
+  gdb.read_available(output, error);
+  if (output.str().empty() && error.str().empty()) {
+    return;
+  }
+
+  int saved_point = rl_point;
+  char * saved_line = rl_copy_text(0, rl_end);
+  rl_save_prompt();
+  rl_replace_line("", 0);
+  rl_redisplay();
+
+  std::cout << output.str() << std::flush;
+  std::cerr << error.str() << std::flush;
+
+  rl_restore_prompt();
+  rl_replace_line(saved_line, 0);
+  rl_point = saved_point;
+  rl_redisplay();
+  free(saved_line);
+
+  // The inferior may have stopped on its own
+  update_gui(gdb);
 }
 
 void open_console(int argc, char ** argv) {
-  // Convert raw C string to standard library string 
+  // Convert raw C string to standard library string, 
+  // keeping gg's own options away from GDB
   std::vector<std::string> args;
+  GDBInterpreter interpreter = GDB_INTERPRETER_MI;
   for (int i = 0; i < argc; i++) {
     char * arg = argv[i];
+    if (i && !strcmp(arg, GG_OPTION_CLI)) {
+      interpreter = GDB_INTERPRETER_CLI;
+      continue;
+    }
     std::string argstr(arg);
     args.push_back(argstr);
   }
 
   // Create instance of GDB
-  GDB gdb(args);
+  GDB gdb(args, interpreter);
+  console_gdb = &gdb;
 
   // Display gdb introduction to user 
   update_console_and_gui(gdb);
 
-  // Keep track of last command executed 
-  const char * last_command = nullptr; 
-
-  // Set deletion flags
-  bool last_command_deletion = true;
-  bool final_command_deletion = true;
-
-  while (gdb.is_alive()) {
-    // Read one line from stdin to process (blocking)
-    const char * command = readline(GDB_PROMPT);
-    last_command_deletion = true;
-
-    // A null pointer signals EOF and GDB should execute quit 
-    if (!command) {
-      // Print quit command
-      std::cout << GDB_QUIT << std::endl;
-
-      // Specify that the quit command should be executed
-      command = GDB_QUIT; 
-
-      // Do not delete the "quit" literal
-      final_command_deletion = false;
+  // Wait on the user and on GDB at once, so whatever GDB writes while the
+  // user is typing shows up right away; readline calls execute_line for
+  // each line the user enters
+  rl_callback_handler_install(GDB_PROMPT, execute_line);
+  while (gdb.is_alive() && !console_closed) {
+    struct pollfd fds[3];
+    fds[0].fd = fileno(stdin);
+    fds[0].events = POLLIN;
+    fds[1].fd = gdb.get_output_event();
+    fds[1].events = POLLIN;
+    fds[2].fd = gui_request_event[0];
+    fds[2].events = POLLIN;
+    if (poll(fds, 3, GG_POLL_TIMEOUT_MS) < 0 && errno != EINTR) {
+      break;
     }
 
-    // GDB handles empty commands by executing the previous command  
-    if (!strlen(command)) {
-      if (!last_command) {
-        continue;
-      }
-      else {
-        command = last_command;
-        last_command_deletion = false;
-      }
+    if (fds[1].revents & POLLIN) {
+      print_available_output(gdb);
     }
-
-    // Execute the command and display result
-    gdb.execute(command);
-    update_console_and_gui(gdb);
-
-    // Add the command to history if user executed something different previously
-    if (!last_command || strcmp(command, last_command)) {
-      add_history(command);
+    if (fds[2].revents & POLLIN) {
+      handle_gui_requests(gdb);
     }
-
-    // The current command becomes last command executed 
-    if (last_command_deletion) {
-      delete last_command;
-      last_command = command;
+    if (fds[0].revents & (POLLIN | POLLHUP)) {
+      rl_callback_read_char();
     }
   }
+  rl_callback_handler_remove();
 
   // Do final deletion - cleanup
-  if (final_command_deletion) {
-    delete last_command;
-  }
+  delete last_command;
+  console_gdb = nullptr;
 }
 
 void open_gui(int argc, char ** argv) {
@@ -157,6 +391,12 @@ void open_gui(int argc, char ** argv) {
 }
 
 int main(int argc, char ** argv) {
+  // The GUI may ask for things as soon as it is up; neither end blocks
+  if (pipe(gui_request_event) == 0) {
+    fcntl(gui_request_event[0], F_SETFL, O_NONBLOCK);
+    fcntl(gui_request_event[1], F_SETFL, O_NONBLOCK);
+  }
+
   // Run GUI on detached thread; main thread will post events to it
   std::thread gui(open_gui, argc, argv);
   gui.detach();
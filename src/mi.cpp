@@ -0,0 +1,507 @@
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MI_HEX_AVX2
+#endif
+
+#include "mi.hpp"
+
+// Alignment of everything carved out of an arena.
+#define MI_ARENA_ALIGNMENT sizeof(void *)
+
+// Cursor over a line of MI output being parsed in place.
+typedef struct {
+  char * position;
+  char * end;
+  MIArena * arena;
+} MIParser;
+
+// Table of characters that may appear in result and async classes.
+static bool mi_is_class_character(char c) {
+  return (c >= 'a' && c <= 'z') || c == '-';
+}
+
+// Returns the character under the cursor, or 0 at the end of the line.
+static inline char mi_peek(MIParser & parser) {
+  return parser.position < parser.end ? *parser.position : 0;
+}
+
+// Advances past the expected character; returns false if it isn't there.
+static inline bool mi_expect(MIParser & parser, char expected) {
+  if (mi_peek(parser) != expected) {
+    return false;
+  }
+  parser.position++;
+  return true;
+}
+
+// Carves a new, empty value out of the arena.
+static MIValue * mi_new_value(MIParser & parser) {
+  MIValue * value = (MIValue *) parser.arena->allocate(sizeof(MIValue));
+  memset(value, 0, sizeof(MIValue));
+  return value;
+}
+
+// Parses a c-string, unescaping it over itself.
+// The unescaped text is never longer than the escaped text, so it can be
+// written behind the read cursor without disturbing what's left to parse.
+static bool mi_parse_string(MIParser & parser, MIString & value) {
+  if (!mi_expect(parser, '"')) {
+    return false;
+  }
+
+  char * read = parser.position;
+  char * write = parser.position;
+  value.data = write;
+
+  // Runs without escapes are found with memchr and only moved if an
+  // earlier escape has shifted the write cursor
+  while (read < parser.end) {
+    char * quote = (char *) memchr(read, '"', parser.end - read);
+    char * backslash = (char *) memchr(read, '\\', (quote ? quote : parser.end) - read);
+    char * stop = backslash ? backslash : quote;
+    if (!stop) {
+      break;
+    }
+
+    if (write != read) {
+      memmove(write, read, stop - read);
+    }
+    write += stop - read;
+    read = stop + 1;
+
+    // Closing quote
+    if (!backslash) {
+      value.size = write - value.data;
+      parser.position = read;
+      return true;
+    }
+
+    if (read >= parser.end) {
+      break;
+    }
+
+    // Escape sequences follow C conventions
+    char c = *read++;
+    switch (c) {
+      case 'n': *write++ = '\n'; break;
+      case 't': *write++ = '\t'; break;
+      case 'r': *write++ = '\r'; break;
+      case 'f': *write++ = '\f'; break;
+      case 'v': *write++ = '\v'; break;
+      case 'b': *write++ = '\b'; break;
+      case 'a': *write++ = '\a'; break;
+      case 'e': *write++ = '\033'; break;
+      default:
+        if (c >= '0' && c <= '7') {
+          // Up to three octal digits
+          int code = c - '0';
+          for (int digits = 1; digits < 3 && read < parser.end &&
+              *read >= '0' && *read <= '7'; digits++) {
+            code = code * 8 + (*read++ - '0');
+          }
+          *write++ = (char) code;
+        }
+        else {
+          *write++ = c;
+        }
+    }
+  }
+
+  // Unterminated string
+  return false;
+}
+
+// Parses a variable name, which runs up to the '='.
+static bool mi_parse_name(MIParser & parser, MIString & name) {
+  name.data = parser.position;
+  while (parser.position < parser.end && *parser.position != '=') {
+    char c = *parser.position;
+    if (c == ',' || c == '{' || c == '}' || c == '[' || c == ']' || c == '"') {
+      return false;
+    }
+    parser.position++;
+  }
+  name.size = parser.position - name.data;
+  return name.size && mi_expect(parser, '=');
+}
+
+static bool mi_parse_value(MIParser & parser, MIValue & value);
+
+// Parses the comma-separated elements of a tuple or list up to the closer,
+// appending each to the end of the chain.
+static bool mi_parse_elements(MIParser & parser, MIValue & value, char closer) {
+  if (mi_expect(parser, closer)) {
+    return true;
+  }
+
+  MIValue ** link = &value.first;
+  do {
+    MIValue * element = mi_new_value(parser);
+    *link = element;
+    link = &element->next;
+    value.count++;
+
+    // Lists may hold bare values; everything else is name=value
+    char c = mi_peek(parser);
+    bool bare = value.type == MI_VALUE_LIST && (c == '"' || c == '{' || c == '[');
+    if ((!bare && !mi_parse_name(parser, element->name)) ||
+        !mi_parse_value(parser, *element)) {
+      return false;
+    }
+  } while (mi_expect(parser, ','));
+
+  return mi_expect(parser, closer);
+}
+
+static bool mi_parse_value(MIParser & parser, MIValue & value) {
+  switch (mi_peek(parser)) {
+    case '"':
+      value.type = MI_VALUE_CONST;
+      return mi_parse_string(parser, value.string);
+    case '{':
+      parser.position++;
+      value.type = MI_VALUE_TUPLE;
+      return mi_parse_elements(parser, value, '}');
+    case '[':
+      parser.position++;
+      value.type = MI_VALUE_LIST;
+      return mi_parse_elements(parser, value, ']');
+    default:
+      return false;
+  }
+}
+
+unsigned long MIString::to_ulong(int base) const {
+  // Numbers in MI output are short; copy to terminate without allocating
+  char digits[32];
+  size_t length = size < sizeof(digits) - 1 ? size : sizeof(digits) - 1;
+  memcpy(digits, data, length);
+  digits[length] = 0;
+  return strtoul(digits, nullptr, base);
+}
+
+long MIString::to_long() const {
+  char digits[32];
+  size_t length = size < sizeof(digits) - 1 ? size : sizeof(digits) - 1;
+  memcpy(digits, data, length);
+  digits[length] = 0;
+  return atol(digits);
+}
+
+MIArena::~MIArena() {
+  for (size_t i = 0; i < blocks.size(); i++) {
+    free(blocks[i]);
+  }
+}
+
+void * MIArena::allocate(size_t size) {
+  size = (size + MI_ARENA_ALIGNMENT - 1) & ~(MI_ARENA_ALIGNMENT - 1);
+
+  // Move on to the next kept block that fits, allocating one only if none do
+  while (current >= blocks.size() || used + size > sizes[current]) {
+    if (current < blocks.size()) {
+      current++;
+      used = 0;
+      continue;
+    }
+
+    size_t block_size = size > MI_ARENA_BLOCK_SIZE ? size : MI_ARENA_BLOCK_SIZE;
+    blocks.push_back((char *) malloc(block_size));
+    sizes.push_back(block_size);
+    allocations++;
+  }
+
+  void * memory = blocks[current] + used;
+  used += size;
+  return memory;
+}
+
+char * MIArena::copy(const char * data, size_t size) {
+  char * memory = (char *) allocate(size);
+  memcpy(memory, data, size);
+  return memory;
+}
+
+const MIValue * MIValue::find(const char * name) const {
+  for (const MIValue * element = first; element; element = element->next) {
+    if (element->name == name) {
+      return element;
+    }
+  }
+  return nullptr;
+}
+
+MIString MIValue::get(const char * name) const {
+  const MIValue * element = find(name);
+  if (!element || element->type != MI_VALUE_CONST) {
+    MIString empty = { "", 0 };
+    return empty;
+  }
+  return element->string;
+}
+
+bool mi_parse_record(char * line, size_t length, MIArena & arena, MIRecord & record) {
+  MIParser parser = { line, line + length, &arena };
+  memset(&record, 0, sizeof(MIRecord));
+  record.token = -1;
+  record.results.type = MI_VALUE_TUPLE;
+  record.text.data = record.record_class.data = "";
+
+  // The prompt may or may not keep its trailing space
+  size_t prompt_length = strlen(MI_PROMPT);
+  if (length >= prompt_length && !memcmp(line, MI_PROMPT, prompt_length)) {
+    size_t i = prompt_length;
+    while (i < length && line[i] == ' ') {
+      i++;
+    }
+    if (i == length) {
+      record.type = MI_RECORD_PROMPT;
+      return true;
+    }
+  }
+
+  // Result and async records may start with a numeric token
+  char * token_end = line;
+  while (token_end < parser.end && *token_end >= '0' && *token_end <= '9') {
+    token_end++;
+  }
+  if (token_end == parser.end) {
+    return false;
+  }
+  if (token_end != line) {
+    MIString token = { line, (size_t) (token_end - line) };
+    record.token = token.to_long();
+  }
+  parser.position = token_end;
+
+  char prefix = *parser.position++;
+  switch (prefix) {
+    case MI_CONSOLE_PREFIX:
+    case MI_TARGET_PREFIX:
+    case MI_LOG_PREFIX:
+      // Streams never carry tokens
+      if (token_end != line) {
+        return false;
+      }
+      record.type = prefix == MI_CONSOLE_PREFIX ? MI_RECORD_CONSOLE :
+        prefix == MI_TARGET_PREFIX ? MI_RECORD_TARGET : MI_RECORD_LOG;
+      return mi_parse_string(parser, record.text) &&
+        parser.position == parser.end;
+    case MI_RESULT_PREFIX:
+      record.type = MI_RECORD_RESULT;
+      break;
+    case MI_EXEC_PREFIX:
+      record.type = MI_RECORD_EXEC;
+      break;
+    case MI_STATUS_PREFIX:
+      record.type = MI_RECORD_STATUS;
+      break;
+    case MI_NOTIFY_PREFIX:
+      record.type = MI_RECORD_NOTIFY;
+      break;
+    default:
+      return false;
+  }
+
+  // The class runs up to the first comma
+  record.record_class.data = parser.position;
+  while (parser.position < parser.end && mi_is_class_character(*parser.position)) {
+    parser.position++;
+  }
+  record.record_class.size = parser.position - record.record_class.data;
+  if (!record.record_class.size) {
+    return false;
+  }
+
+  // Followed by comma-separated results
+  MIValue ** link = &record.results.first;
+  while (mi_expect(parser, ',')) {
+    MIValue * result = mi_new_value(parser);
+    *link = result;
+    link = &result->next;
+    record.results.count++;
+    if (!mi_parse_name(parser, result->name) || !mi_parse_value(parser, *result)) {
+      return false;
+    }
+  }
+
+  return parser.position == parser.end;
+}
+
+std::string mi_quote(const std::string & text) {
+  std::string quoted("\"");
+  for (size_t i = 0; i < text.size(); i++) {
+    char c = text[i];
+    switch (c) {
+      case '"': quoted.append("\\\""); break;
+      case '\\': quoted.append("\\\\"); break;
+      case '\n': quoted.append("\\n"); break;
+      case '\t': quoted.append("\\t"); break;
+      default: quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+void mi_variables(const MIValue & value, bool argument, std::vector<MIVariable> & variables) {
+  for (const MIValue * element = value.first; element; element = element->next) {
+    // -stack-list-variables marks arguments itself
+    MIVariable variable;
+    variable.name = element->get("name").str();
+    variable.value = element->get("value").str();
+    variable.argument = argument || element->find("arg");
+    variables.push_back(variable);
+  }
+}
+
+// Converts one hex digit; returns -1 for anything else.
+static inline int mi_hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+#if defined(__SSE2__)
+// Converts 16 hex digits to their values, setting a bit of valid for each
+// character that is a digit.
+static inline __m128i mi_hex_values(__m128i text, int & valid) {
+  __m128i lower = _mm_or_si128(text, _mm_set1_epi8(0x20));
+  __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(text, _mm_set1_epi8('0' - 1)), 
+      _mm_cmplt_epi8(text, _mm_set1_epi8('9' + 1)));
+  __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), 
+      _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+  valid = _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter));
+  return _mm_or_si128(
+      _mm_and_si128(is_digit, _mm_sub_epi8(text, _mm_set1_epi8('0'))),
+      _mm_and_si128(is_letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+// Joins the values of 16 digits pairwise, high digit first, into the low
+// half of each 16-bit lane.
+static inline __m128i mi_hex_pairs(__m128i values) {
+  __m128i high = _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00ff)), 4);
+  return _mm_or_si128(high, _mm_srli_epi16(values, 8));
+}
+
+// Decodes 32 digits at a time for as long as they are all hex; returns
+// the number of bytes decoded.
+static size_t mi_decode_hex_sse2(const char * digits, size_t count, unsigned char * bytes) {
+  size_t decoded = 0;
+  for (; count - 2 * decoded >= 32; decoded += 16) {
+    int valid_first, valid_second;
+    __m128i first = mi_hex_values(
+        _mm_loadu_si128((const __m128i *) (digits + 2 * decoded)), valid_first);
+    __m128i second = mi_hex_values(
+        _mm_loadu_si128((const __m128i *) (digits + 2 * decoded + 16)), valid_second);
+    if ((valid_first & valid_second) != 0xffff) {
+      break;
+    }
+    _mm_storeu_si128((__m128i *) (bytes + decoded), 
+        _mm_packus_epi16(mi_hex_pairs(first), mi_hex_pairs(second)));
+  }
+  return decoded;
+}
+#endif
+
+#ifdef MI_HEX_AVX2
+// Same as mi_hex_values, for 32 digits.
+__attribute__((target("avx2")))
+static inline __m256i mi_hex_values_avx2(__m256i text, unsigned & valid) {
+  __m256i lower = _mm256_or_si256(text, _mm256_set1_epi8(0x20));
+  __m256i is_digit = _mm256_and_si256(_mm256_cmpgt_epi8(text, _mm256_set1_epi8('0' - 1)), 
+      _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), text));
+  __m256i is_letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), 
+      _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+  valid = (unsigned) _mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter));
+  return _mm256_or_si256(
+      _mm256_and_si256(is_digit, _mm256_sub_epi8(text, _mm256_set1_epi8('0'))),
+      _mm256_and_si256(is_letter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+}
+
+// Same as mi_hex_pairs, for 32 digits.
+__attribute__((target("avx2")))
+static inline __m256i mi_hex_pairs_avx2(__m256i values) {
+  __m256i high = _mm256_slli_epi16(_mm256_and_si256(values, _mm256_set1_epi16(0x00ff)), 4);
+  return _mm256_or_si256(high, _mm256_srli_epi16(values, 8));
+}
+
+// Same as mi_decode_hex_sse2, 64 digits at a time.
+__attribute__((target("avx2")))
+static size_t mi_decode_hex_avx2(const char * digits, size_t count, unsigned char * bytes) {
+  size_t decoded = 0;
+  for (; count - 2 * decoded >= 64; decoded += 32) {
+    unsigned valid_first, valid_second;
+    __m256i first = mi_hex_values_avx2(
+        _mm256_loadu_si256((const __m256i *) (digits + 2 * decoded)), valid_first);
+    __m256i second = mi_hex_values_avx2(
+        _mm256_loadu_si256((const __m256i *) (digits + 2 * decoded + 32)), valid_second);
+    if ((valid_first & valid_second) != 0xffffffffu) {
+      break;
+    }
+    // Packing works within 128-bit halves, so the quarters come out of order
+    __m256i packed = _mm256_packus_epi16(mi_hex_pairs_avx2(first), mi_hex_pairs_avx2(second));
+    _mm256_storeu_si256((__m256i *) (bytes + decoded), 
+        _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  return decoded;
+}
+#endif
+
+size_t mi_decode_hex(const char * digits, size_t count, unsigned char * bytes) {
+  size_t decoded = 0;
+#ifdef MI_HEX_AVX2
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    decoded = mi_decode_hex_avx2(digits, count, bytes);
+  }
+#endif
+#if defined(__SSE2__)
+  decoded += mi_decode_hex_sse2(digits + 2 * decoded, count - 2 * decoded, bytes + decoded);
+#endif
+
+  // What is left over, or the whole text without vector instructions
+  for (; 2 * decoded + 1 < count; decoded++) {
+    int high = mi_hex_digit(digits[2 * decoded]);
+    int low = mi_hex_digit(digits[2 * decoded + 1]);
+    if (high < 0 || low < 0) {
+      break;
+    }
+    bytes[decoded] = (unsigned char) (high << 4 | low);
+  }
+  return decoded;
+}
+
+bool mi_memory(const MIValue & value, MIMemory & memory) {
+  if (!value.first) {
+    return false;
+  }
+
+  // Blocks start at begin + offset
+  const MIValue & block = *value.first;
+  memory.begin = block.get("begin").to_ulong(16) + block.get("offset").to_ulong(16);
+
+  // Contents are two hex digits per byte, decoded straight from the view
+  MIString contents = block.get("contents");
+  memory.contents.resize(contents.size / 2);
+  memory.contents.resize(mi_decode_hex(contents.data, contents.size, memory.contents.data()));
+  return true;
+}
+
+void mi_instructions(const MIValue & value, std::vector<MIInstruction> & instructions) {
+  for (const MIValue * element = value.first; element; element = element->next) {
+    MIInstruction instruction;
+    instruction.address = element->get("address").to_ulong(16);
+    instruction.function = element->get("func-name").str();
+    instruction.offset = element->get("offset").to_long();
+    instruction.instruction = element->get("inst").str();
+    instructions.push_back(instruction);
+  }
+}
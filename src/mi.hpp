@@ -0,0 +1,194 @@
+#ifndef GG_MI_HPP
+#define GG_MI_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Prefixes that identify each kind of GDB/MI output record.
+#define MI_RESULT_PREFIX '^'
+#define MI_EXEC_PREFIX '*'
+#define MI_STATUS_PREFIX '+'
+#define MI_NOTIFY_PREFIX '='
+#define MI_CONSOLE_PREFIX '~'
+#define MI_TARGET_PREFIX '@'
+#define MI_LOG_PREFIX '&'
+#define MI_PROMPT "(gdb)"
+
+// Result and async classes gg reacts to.
+#define MI_CLASS_DONE "done"
+#define MI_CLASS_RUNNING "running"
+#define MI_CLASS_ERROR "error"
+#define MI_CLASS_STOPPED "stopped"
+#define MI_CLASS_THREAD_GROUP_STARTED "thread-group-started"
+#define MI_CLASS_THREAD_GROUP_EXITED "thread-group-exited"
+#define MI_CLASS_THREAD_SELECTED "thread-selected"
+#define MI_CLASS_MEMORY_CHANGED "memory-changed"
+#define MI_CLASS_BREAKPOINT_CREATED "breakpoint-created"
+#define MI_CLASS_BREAKPOINT_MODIFIED "breakpoint-modified"
+#define MI_CLASS_BREAKPOINT_DELETED "breakpoint-deleted"
+
+// Size of each block an arena carves values out of.
+#define MI_ARENA_BLOCK_SIZE (64 * 1024)
+
+// A view of characters owned by someone else (a read buffer or an arena).
+struct MIString {
+  const char * data;
+  size_t size;
+
+  // Returns true if the view holds exactly the given text.
+  bool operator==(const char * text) const {
+    return !strncmp(data, text, size) && !text[size];
+  }
+
+  bool operator!=(const char * text) const {
+    return !(*this == text);
+  }
+
+  bool empty() const {
+    return !size;
+  }
+
+  // Copies the viewed characters into a string.
+  std::string str() const {
+    return std::string(data, size);
+  }
+
+  // Parses the viewed characters as a number in the given base
+  // (0 detects the base from a 0x or 0 prefix).
+  unsigned long to_ulong(int base) const;
+
+  long to_long() const;
+};
+
+// Bump allocator that all values of a reply are carved out of.
+// Nothing is freed individually: reset() releases everything at once and
+// keeps the blocks, so parsing reply after reply allocates no memory.
+class MIArena {
+  std::vector<char *> blocks; // Every block ever allocated, all kept for reuse
+  std::vector<size_t> sizes; // Size of each block
+  size_t current; // Index of the block being carved
+  size_t used; // Bytes carved out of the current block
+  long allocations; // Number of blocks ever allocated
+  public:
+  MIArena() : current(0), used(0), allocations(0) {}
+
+  ~MIArena();
+
+  // Carves out size bytes aligned for any value type.
+  void * allocate(size_t size);
+
+  // Copies characters into the arena.
+  char * copy(const char * data, size_t size);
+
+  // Releases everything carved so far.
+  void reset() {
+    current = 0;
+    used = 0;
+  }
+
+  // Gets the number of blocks that have been allocated from the heap.
+  long get_allocations() const {
+    return allocations;
+  }
+  private:
+  MIArena(const MIArena &);
+  MIArena & operator=(const MIArena &);
+};
+
+// Kinds of values that appear in GDB/MI output.
+enum MIValueType {
+  MI_VALUE_CONST, // A c-string
+  MI_VALUE_TUPLE, // {name=value,...}
+  MI_VALUE_LIST   // [value,...] or [name=value,...]
+};
+
+// A GDB/MI value. Tuples and lists chain their elements in order from
+// first through next; each element carries its own name (empty for
+// unnamed list elements).
+struct MIValue {
+  MIValueType type;
+  MIString name; // Name of this element in its parent
+  MIString string; // Unescaped text, only for constants
+  MIValue * first; // First element of a tuple or list
+  MIValue * next; // Next element of the parent
+  size_t count; // Number of elements of a tuple or list
+
+  // Gets the first element with the given name, or null if there is none.
+  const MIValue * find(const char * name) const;
+
+  // Gets the text of the constant element with the given name, or an empty
+  // view if there is no such element.
+  MIString get(const char * name) const;
+};
+
+// Kinds of records (lines) in GDB/MI output.
+enum MIRecordType {
+  MI_RECORD_RESULT,  // ^done, ^running, ^error, ...
+  MI_RECORD_EXEC,    // *stopped, *running
+  MI_RECORD_STATUS,  // +download
+  MI_RECORD_NOTIFY,  // =thread-group-started, =breakpoint-modified, ...
+  MI_RECORD_CONSOLE, // ~"text" from the CLI
+  MI_RECORD_TARGET,  // @"text" from the target
+  MI_RECORD_LOG,     // &"text" from GDB's internals
+  MI_RECORD_PROMPT   // (gdb)
+};
+
+// A parsed line of GDB/MI output. Every view points either into the line
+// that was parsed or into the arena the values were carved from.
+struct MIRecord {
+  MIRecordType type;
+  long token; // Token the command was sent with, -1 if none
+  MIString record_class; // Class of result and async records (e.g. "done")
+  MIValue results; // Results of result and async records, as a tuple
+  MIString text; // Unescaped text of stream records
+};
+
+// A local variable or argument with its value.
+typedef struct {
+  std::string name;
+  std::string value;
+  bool argument;
+} MIVariable;
+
+// A block of memory as returned by -data-read-memory-bytes.
+typedef struct {
+  unsigned long begin;
+  std::vector<unsigned char> contents;
+} MIMemory;
+
+// A disassembled instruction as returned by -data-disassemble.
+typedef struct {
+  unsigned long address;
+  std::string function;
+  long offset;
+  std::string instruction;
+} MIInstruction;
+
+// Parses one line of GDB/MI output (without its newline) in place.
+// Escaped strings are unescaped inside the line itself, so the line must
+// stay alive and untouched for as long as the record is used; tuples and
+// lists are carved out of the arena. No heap memory is allocated once the
+// arena has grown to the size of the largest reply.
+// Returns false if the line is not MI output, e.g. output of the inferior.
+bool mi_parse_record(char * line, size_t length, MIArena & arena, MIRecord & record);
+
+// Quotes text as an MI c-string, e.g. for -interpreter-exec arguments.
+std::string mi_quote(const std::string & text);
+
+// Converts a list of {name,value} tuples, as in locals=[...] or args=[...].
+void mi_variables(const MIValue & value, bool argument, std::vector<MIVariable> & variables);
+
+// Decodes count hex digits into count / 2 bytes, 32 or 16 bytes at a time
+// on processors with AVX2 or SSE2. Stops at the first pair that isn't hex;
+// returns the number of bytes decoded.
+size_t mi_decode_hex(const char * digits, size_t count, unsigned char * bytes);
+
+// Converts the first block of a memory=[{begin,contents}] list.
+bool mi_memory(const MIValue & value, MIMemory & memory);
+
+// Converts an asm_insns=[{address,func-name,offset,inst}] list.
+void mi_instructions(const MIValue & value, std::vector<MIInstruction> & instructions);
+
+#endif
@@ -0,0 +1,285 @@
+#include <cstring>
+
+#include "syntax.hpp"
+
+// Words highlighted in C and C++.
+static const char * syntax_keywords[] = {
+  "alignas", "alignof", "asm", "auto", "break", "case", "catch", "class",
+  "const", "const_cast", "constexpr", "continue", "decltype", "default",
+  "delete", "do", "dynamic_cast", "else", "enum", "explicit", "export",
+  "extern", "false", "final", "for", "friend", "goto", "if", "inline",
+  "mutable", "namespace", "new", "noexcept", "nullptr", "operator",
+  "override", "private", "protected", "public", "register",
+  "reinterpret_cast", "restrict", "return", "sizeof", "static",
+  "static_assert", "static_cast", "struct", "switch", "template", "this",
+  "thread_local", "throw", "true", "try", "typedef", "typeid", "typename",
+  "union", "using", "virtual", "volatile", "while"
+};
+
+static const char * syntax_types[] = {
+  "bool", "char", "char16_t", "char32_t", "double", "float", "int", "int16_t",
+  "int32_t", "int64_t", "int8_t", "intptr_t", "long", "ptrdiff_t", "short",
+  "signed", "size_t", "ssize_t", "uint16_t", "uint32_t", "uint64_t",
+  "uint8_t", "uintptr_t", "unsigned", "void", "wchar_t"
+};
+
+// Extensions of C and C++ sources and headers.
+static const char * syntax_c_extensions[] = {
+  "C", "H", "c", "c++", "cc", "cp", "cpp", "cxx", "h", "h++", "hh", "hpp",
+  "hxx", "inl", "ipp", "tcc", nullptr
+};
+
+#define SYNTAX_COUNT(words) (sizeof(words) / sizeof(words[0]))
+
+// A word highlighted in C and C++.
+typedef struct {
+  const char * word;
+  size_t length;
+  SyntaxKind kind;
+} SyntaxWord;
+
+// The words by their first letter; all of them are lower case.
+typedef struct {
+  std::vector<SyntaxWord> words[26];
+} SyntaxWordIndex;
+
+// Bytes of UTF-8 sequences count as letters, so names in any script lex whole.
+static inline bool syntax_is_letter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (c & 0x80);
+}
+
+static inline bool syntax_is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static inline bool syntax_is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Adds words of a kind to an index.
+static void syntax_index_words(SyntaxWordIndex & index, const char ** words, size_t count,
+    SyntaxKind kind)
+{
+  for (size_t i = 0; i < count; i++) {
+    SyntaxWord word = { words[i], strlen(words[i]), kind };
+    index.words[words[i][0] - 'a'].push_back(word);
+  }
+}
+
+static SyntaxWordIndex syntax_index_words() {
+  SyntaxWordIndex index;
+  syntax_index_words(index, syntax_keywords, SYNTAX_COUNT(syntax_keywords), SYNTAX_KEYWORD);
+  syntax_index_words(index, syntax_types, SYNTAX_COUNT(syntax_types), SYNTAX_TYPE);
+  return index;
+}
+
+// Gets the kind of a word, plain if it isn't highlighted. Identifiers are
+// the most common tokens, so most are turned away by their first letter
+// and length without comparing any text.
+static SyntaxKind syntax_find_word(const char * word, size_t length) {
+  static const SyntaxWordIndex index = syntax_index_words();
+  if (word[0] < 'a' || word[0] > 'z') {
+    return SYNTAX_PLAIN;
+  }
+  const std::vector<SyntaxWord> & words = index.words[word[0] - 'a'];
+  for (size_t i = 0; i < words.size(); i++) {
+    if (words[i].length == length && !memcmp(words[i].word, word, length)) {
+      return words[i].kind;
+    }
+  }
+  return SYNTAX_PLAIN;
+}
+
+static inline void syntax_add(std::vector<SyntaxSpan> & spans, size_t begin, size_t end,
+    SyntaxKind kind)
+{
+  SyntaxSpan span = { (uint32_t) begin, (uint32_t) (end - begin), kind };
+  spans.push_back(span);
+}
+
+// Finds the end of a number starting at begin, e.g. 0x1f, 1'000, 1.5e-3f.
+static size_t syntax_skip_number(const char * text, size_t begin, size_t length) {
+  size_t i = begin;
+  while (i < length && (syntax_is_letter(text[i]) || syntax_is_digit(text[i]) ||
+        text[i] == '.' || text[i] == '\'')) {
+    char c = text[i++];
+    bool exponent = c == 'e' || c == 'E' || c == 'p' || c == 'P';
+    if (exponent && i < length && (text[i] == '+' || text[i] == '-')) {
+      i++;
+    }
+  }
+  return i;
+}
+
+void syntax_lex_c_line(const char * text, size_t length, SyntaxState & state,
+    std::vector<SyntaxSpan> & spans)
+{
+  bool continued = length && text[length - 1] == '\\';
+  size_t i = 0;
+
+  // Lines inside a directive belong to it, up to one that isn't continued
+  if (state == SYNTAX_STATE_PREPROCESSOR) {
+    if (length) {
+      syntax_add(spans, 0, length, SYNTAX_PREPROCESSOR);
+    }
+    state = continued ? SYNTAX_STATE_PREPROCESSOR : SYNTAX_STATE_CODE;
+    return;
+  }
+
+  // Finish a comment left open by the lines before
+  if (state == SYNTAX_STATE_COMMENT) {
+    const char * close = (const char *) memmem(text, length, "*/", 2);
+    if (!close) {
+      if (length) {
+        syntax_add(spans, 0, length, SYNTAX_COMMENT);
+      }
+      return;
+    }
+    i = close + 2 - text;
+    syntax_add(spans, 0, i, SYNTAX_COMMENT);
+    state = SYNTAX_STATE_CODE;
+  }
+
+  bool line_start = i == 0;
+  while (i < length) {
+    char c = text[i];
+    if (syntax_is_space(c)) {
+      i++;
+      continue;
+    }
+
+    // Directives only start lines
+    if (c == '#' && line_start) {
+      syntax_add(spans, i, length, SYNTAX_PREPROCESSOR);
+      state = continued ? SYNTAX_STATE_PREPROCESSOR : SYNTAX_STATE_CODE;
+      return;
+    }
+    line_start = false;
+
+    size_t begin = i;
+    if (c == '/' && i + 1 < length && text[i + 1] == '/') {
+      syntax_add(spans, i, length, SYNTAX_COMMENT);
+      return;
+    }
+    else if (c == '/' && i + 1 < length && text[i + 1] == '*') {
+      const char * close = (const char *) memmem(text + i + 2, length - i - 2, "*/", 2);
+      if (!close) {
+        syntax_add(spans, i, length, SYNTAX_COMMENT);
+        state = SYNTAX_STATE_COMMENT;
+        return;
+      }
+      i = close + 2 - text;
+      syntax_add(spans, begin, i, SYNTAX_COMMENT);
+    }
+    else if (c == '"' || c == '\'') {
+      // Unterminated literals end with the line
+      for (i++; i < length && text[i] != c; i++) {
+        if (text[i] == '\\') {
+          i++;
+        }
+      }
+      i = i < length ? i + 1 : length;
+      syntax_add(spans, begin, i, SYNTAX_STRING);
+    }
+    else if (syntax_is_digit(c) || (c == '.' && i + 1 < length && syntax_is_digit(text[i + 1]))) {
+      i = syntax_skip_number(text, i, length);
+      syntax_add(spans, begin, i, SYNTAX_NUMBER);
+    }
+    else if (syntax_is_letter(c)) {
+      while (i < length && (syntax_is_letter(text[i]) || syntax_is_digit(text[i]))) {
+        i++;
+      }
+      SyntaxKind kind = syntax_find_word(text + begin, i - begin);
+      if (kind != SYNTAX_PLAIN) {
+        syntax_add(spans, begin, i, kind);
+      }
+    }
+    else {
+      i++;
+    }
+  }
+}
+
+void syntax_lex_assembly_line(const char * text, size_t length, std::vector<SyntaxSpan> & spans) {
+  // Skip the marker of the instruction being executed
+  size_t i = 0;
+  while (i < length && (syntax_is_space(text[i]) || text[i] == '=' || text[i] == '>')) {
+    i++;
+  }
+
+  // Lines that don't start with an address, such as "Dump of assembler
+  // code", are left plain
+  if (i + 2 > length || text[i] != '0' || text[i + 1] != 'x') {
+    return;
+  }
+  size_t begin = i;
+  i = syntax_skip_number(text, i, length);
+  syntax_add(spans, begin, i, SYNTAX_ADDRESS);
+
+  // The offset into the function comes before the colon
+  while (i < length && text[i] != '<' && text[i] != ':') {
+    i++;
+  }
+  if (i < length && text[i] == '<') {
+    begin = i;
+    const char * close = (const char *) memchr(text + i, '>', length - i);
+    i = close ? close + 1 - text : length;
+    syntax_add(spans, begin, i, SYNTAX_SYMBOL);
+  }
+  while (i < length && (text[i] == ':' || syntax_is_space(text[i]))) {
+    i++;
+  }
+
+  // Then the mnemonic
+  begin = i;
+  while (i < length && !syntax_is_space(text[i])) {
+    i++;
+  }
+  if (i > begin) {
+    syntax_add(spans, begin, i, SYNTAX_KEYWORD);
+  }
+
+  // Then the operands, in either AT&T or Intel syntax
+  while (i < length) {
+    char c = text[i];
+    begin = i;
+    if (c == '#') {
+      syntax_add(spans, i, length, SYNTAX_COMMENT);
+      return;
+    }
+    else if (c == '<') {
+      const char * close = (const char *) memchr(text + i, '>', length - i);
+      i = close ? close + 1 - text : length;
+      syntax_add(spans, begin, i, SYNTAX_SYMBOL);
+    }
+    else if (c == '%' || syntax_is_letter(c)) {
+      for (i++; i < length && (syntax_is_letter(text[i]) || syntax_is_digit(text[i])); i++) {
+      }
+
+      // Intel syntax names registers bare and sizes in capitals
+      bool size = c >= 'A' && c <= 'Z';
+      syntax_add(spans, begin, i, size ? SYNTAX_TYPE : SYNTAX_REGISTER);
+    }
+    else if (c == '$' || syntax_is_digit(c) ||
+        (c == '-' && i + 1 < length && syntax_is_digit(text[i + 1]))) {
+      i = syntax_skip_number(text, i + 1, length);
+      syntax_add(spans, begin, i, SYNTAX_NUMBER);
+    }
+    else {
+      i++;
+    }
+  }
+}
+
+bool syntax_is_c_path(const std::string & path) {
+  size_t dot = path.rfind('.');
+  if (dot == std::string::npos || path.find('/', dot) != std::string::npos) {
+    return false;
+  }
+  for (size_t i = 0; syntax_c_extensions[i]; i++) {
+    if (!path.compare(dot + 1, std::string::npos, syntax_c_extensions[i])) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,81 @@
+#ifndef GG_SYNTAX_HPP
+#define GG_SYNTAX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Kinds of tokens that are highlighted; everything else is plain text.
+enum SyntaxKind {
+  SYNTAX_PLAIN,
+  SYNTAX_KEYWORD,      // Statements and storage classes, or instruction mnemonics
+  SYNTAX_TYPE,         // Built-in types
+  SYNTAX_STRING,       // String and character literals
+  SYNTAX_NUMBER,       // Numeric literals and immediates
+  SYNTAX_COMMENT,
+  SYNTAX_PREPROCESSOR, // Directives, up to the end of the (continued) line
+  SYNTAX_REGISTER,     // Registers in disassembly
+  SYNTAX_SYMBOL,       // <function+offset> in disassembly
+  SYNTAX_ADDRESS,      // Instruction addresses in disassembly
+  SYNTAX_KIND_COUNT
+};
+
+// A highlighted run of a line, in bytes.
+typedef struct {
+  uint32_t begin;
+  uint32_t length;
+  SyntaxKind kind;
+} SyntaxSpan;
+
+// What a line of C ends inside of, which carries over to the next line.
+enum SyntaxState {
+  SYNTAX_STATE_CODE,
+  SYNTAX_STATE_COMMENT,     // A /* comment */ not closed yet
+  SYNTAX_STATE_PREPROCESSOR // A directive continued with a backslash
+};
+
+// Lexes a line of C or C++, appending its highlighted spans in order.
+// The state carries comments and directives that run on to the next line.
+void syntax_lex_c_line(const char * text, size_t length, SyntaxState & state,
+    std::vector<SyntaxSpan> & spans);
+
+// Lexes a line of disassembly as GDB prints it, e.g.
+// "=> 0x0000555555555189 <+8>:\tmov    %rsp,%rbp", appending its spans.
+void syntax_lex_assembly_line(const char * text, size_t length, std::vector<SyntaxSpan> & spans);
+
+// Returns true if a path names a C or C++ source or header.
+bool syntax_is_c_path(const std::string & path);
+
+// The spans of every line of a file, lexed one line after another and
+// kept in a single array.
+class SyntaxLines {
+  std::vector<SyntaxSpan> spans; // Spans of every line, in order
+  std::vector<size_t> line_spans; // Where the spans of each line start, then where the last ones end
+  SyntaxState state; // State the last line lexed ended in
+  public:
+  SyntaxLines() : line_spans(1, 0), state(SYNTAX_STATE_CODE) {}
+
+  // Lexes the line after the last one added as C or C++.
+  void add_c_line(const char * text, size_t length) {
+    syntax_lex_c_line(text, length, state, spans);
+    line_spans.push_back(spans.size());
+  }
+
+  // Gets the number of lines added.
+  long get_line_count() const {
+    return (long) line_spans.size() - 1;
+  }
+
+  // Gets the spans of a line (1-based), setting count to their number.
+  const SyntaxSpan * get_line(long line, size_t & count) const {
+    if (line < 1 || line > get_line_count()) {
+      count = 0;
+      return nullptr;
+    }
+    count = line_spans[line] - line_spans[line - 1];
+    return spans.data() + line_spans[line - 1];
+  }
+};
+
+#endif
@@ -0,0 +1,50 @@
+// Helpers shared by the microbenchmarks: the split() and string_ends_with()
+// helpers gg used to scrape CLI output with, and a timing loop.
+
+#ifndef GG_BENCH_HPP
+#define GG_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+template<typename Out>
+void split(const std::string &s, char delim, Out result) {
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, delim)) {
+        *(result++) = item;
+    }
+}
+
+inline std::vector<std::string> split(const std::string &s, char delim) {
+    std::vector<std::string> elems;
+    split(s, delim, std::back_inserter(elems));
+    return elems;
+}
+
+inline bool string_ends_with(std::string const & str, std::string const & ending) {
+  if (ending.size() > str.size()) 
+    return false;
+  return std::equal(ending.rbegin(), ending.rend(), str.rbegin());
+}
+
+// Runs work over bytes of input and prints its throughput. The work returns
+// a checksum so it isn't optimized out.
+template<typename Work>
+void run(const char * name, size_t bytes, long iterations, Work work) {
+  size_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) {
+    checksum += work();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double megabytes = (double) bytes * iterations / (1024 * 1024);
+  printf("%-10s %9.1f MB/s  (%.3f s, checksum %zu)\n", name, megabytes / seconds, seconds, checksum);
+}
+
+#endif
@@ -0,0 +1,94 @@
+// Tests for how console commands are classified: which ones may change the
+// inferior, whose replies may be cached, and which leave the cache alone.
+//
+// Usage: commandtest
+
+#include <cstdio>
+
+#include "../src/command.hpp"
+
+// A command and how it should be classified.
+typedef struct {
+  const char * command;
+  bool side_effects;
+  bool cacheable;
+  bool harmless;
+} CommandCase;
+
+static const CommandCase command_cases[] = {
+  // Queries that only depend on where the inferior is stopped
+  { "info locals", false, true, true },
+  { "info registers $pc", false, true, true },
+  { "output a + b", false, true, true },
+  { "output x << 1 == 2", false, true, true },
+  { "output x <= 1", false, true, true },
+  { "output x >= 1", false, true, true },
+  { "output x != 1", false, true, true },
+  { "ptype struct node", false, true, true },
+  { "whatis x", false, true, true },
+  { "show version", false, true, true },
+  { "bt", false, true, true },
+  { "  where", false, true, true },
+
+  // Expressions that change the inferior
+  { "output x = 1", true, false, false },
+  { "output x <<= 1", true, false, false },
+  { "output x >>= 1", true, false, false },
+  { "output x += 1", true, false, false },
+  { "output x++", true, false, false },
+  { "output --x", true, false, false },
+  { "output f(1)", true, false, false },
+  { "p x <<= 1", true, false, false },
+  { "p x>>=1", true, false, false },
+  { "p x = 1", true, false, false },
+  { "call f()", true, false, false },
+
+  // Commands that set the value history or $_, which a repeat has to set again
+  { "p x", false, false, true },
+  { "p/x x", false, false, true },
+  { "print x == 1", false, false, true },
+  { "x/4x $sp", false, false, true },
+  { "x $sp", false, false, true },
+  { "info line main", false, false, true },
+  { "info breakpoints", false, false, true },
+
+  // Commands that read the value history or $_, which print and x change
+  { "output $", false, false, true },
+  { "output $$", false, false, true },
+  { "output $$2", false, false, true },
+  { "output $1 + 1", false, false, true },
+  { "output $_", false, false, true },
+  { "output $__", false, false, true },
+  { "info registers $", false, false, true },
+  { "show values", false, false, true },
+  { "show convenience", false, false, true },
+
+  // Commands that don't touch the inferior but aren't worth caching
+  { "list", false, false, true },
+  { "help x", false, false, true },
+
+  // Commands that move the inferior
+  { "next", false, false, false },
+  { "continue", false, false, false },
+  { "set var x = 1", true, false, false },
+};
+
+int main() {
+  int failures = 0;
+  size_t count = sizeof(command_cases) / sizeof(command_cases[0]);
+  for (size_t i = 0; i < count; i++) {
+    const CommandCase & test = command_cases[i];
+    bool side_effects = command_has_side_effects(test.command);
+    bool cacheable = command_is_cacheable(test.command);
+    bool harmless = command_is_harmless(test.command);
+    if (side_effects != test.side_effects || cacheable != test.cacheable || 
+        harmless != test.harmless) {
+      printf("FAIL \"%s\": side effects %d, cacheable %d, harmless %d; expected %d, %d, %d\n",
+          test.command, side_effects, cacheable, harmless, 
+          test.side_effects, test.cacheable, test.harmless);
+      failures++;
+    }
+  }
+  printf("%zu commands, %d failed\n", count, failures);
+  return failures ? 1 : 0;
+}
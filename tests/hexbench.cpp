@@ -0,0 +1,129 @@
+// Microbenchmark for reading memory through GDB.
+// Decodes a 1 MB block of memory as GDB prints it for x/<n>bx, tokenized
+// the way gg's stack panel used to read it, and as the contiguous hex of
+// -data-read-memory-bytes, once with a plain loop and once with the
+// vectorized decoder gg uses, and reports the throughput of each in MB of
+// memory per second.
+//
+// Usage: hexbench [bytes] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/mi.hpp"
+#include "bench.hpp"
+
+#define HEXBENCH_DEFAULT_BYTES (1024 * 1024)
+#define HEXBENCH_DEFAULT_ITERATIONS 10
+#define HEXBENCH_ADDRESS 0x7fffffef0000UL
+#define HEXBENCH_BYTES_PER_LINE 8
+
+// Builds the memory being read.
+std::vector<unsigned char> make_memory(size_t bytes) {
+  std::vector<unsigned char> memory(bytes);
+  for (size_t i = 0; i < bytes; i++) {
+    memory[i] = (unsigned char) (i * 7 + (i >> 9));
+  }
+  return memory;
+}
+
+// Prints memory the way GDB answers x/<n>bx, e.g.
+// "0x7fffffffe490:\t0x00\t0x01\t...".
+std::string examine_output(const std::vector<unsigned char> & memory) {
+  std::string output;
+  char token[32];
+  for (size_t i = 0; i < memory.size(); i++) {
+    if (i % HEXBENCH_BYTES_PER_LINE == 0) {
+      snprintf(token, sizeof(token), "%s0x%lx:", i ? "\n" : "", HEXBENCH_ADDRESS + i);
+      output += token;
+    }
+    snprintf(token, sizeof(token), "\t0x%02x", memory[i]);
+    output += token;
+  }
+  return output + "\n";
+}
+
+// Prints memory the way GDB answers -data-read-memory-bytes.
+std::string compact_output(const std::vector<unsigned char> & memory) {
+  static const char * digits = "0123456789abcdef";
+  std::string output;
+  for (size_t i = 0; i < memory.size(); i++) {
+    output += digits[memory[i] >> 4];
+    output += digits[memory[i] & 15];
+  }
+  return output;
+}
+
+// Reads x/<n>bx output one token at a time, as get_stack_frame did.
+size_t decode_tokens(const std::string & output, std::vector<long> & memory) {
+  long index = 0;
+  for(std::string line : split(output, '\n')) {
+    for (std::string token : split(line, '\t')) {
+      if (!string_ends_with(token, ":")) {
+        memory[index++] = std::stol(token, nullptr, 16);
+      }
+    }
+  }
+  return index;
+}
+
+// Converts one hex digit; returns -1 for anything else.
+static inline int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Reads contiguous hex a byte at a time, as mi_memory did.
+size_t decode_scalar(const std::string & output, std::vector<unsigned char> & memory) {
+  size_t i = 0;
+  for (; i < output.size() / 2; i++) {
+    int high = hex_digit(output[2 * i]);
+    int low = hex_digit(output[2 * i + 1]);
+    if (high < 0 || low < 0) {
+      break;
+    }
+    memory[i] = (unsigned char) (high << 4 | low);
+  }
+  return i;
+}
+
+int main(int argc, char ** argv) {
+  size_t bytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : HEXBENCH_DEFAULT_BYTES;
+  long iterations = argc > 2 ? atol(argv[2]) : HEXBENCH_DEFAULT_ITERATIONS;
+
+  std::vector<unsigned char> memory = make_memory(bytes);
+  std::string examined = examine_output(memory);
+  std::string compact = compact_output(memory);
+
+  // Make sure every decoder reads back the same memory
+  std::vector<long> tokens(bytes);
+  std::vector<unsigned char> scalar(bytes);
+  std::vector<unsigned char> vectorized(bytes);
+  if (decode_tokens(examined, tokens) != bytes ||
+      decode_scalar(compact, scalar) != bytes ||
+      mi_decode_hex(compact.data(), compact.size(), vectorized.data()) != bytes) {
+    std::cerr << "hexbench: a decoder stopped short" << std::endl;
+    return 1;
+  }
+  for (size_t i = 0; i < bytes; i++) {
+    if (tokens[i] != memory[i] || scalar[i] != memory[i] || vectorized[i] != memory[i]) {
+      std::cerr << "hexbench: byte " << i << " decoded wrong" << std::endl;
+      return 1;
+    }
+  }
+
+  printf("%zu bytes of memory, %zu bytes as x/bx, %zu bytes as hex, %ld iterations\n",
+      bytes, examined.size(), compact.size(), iterations);
+  run("tokens", bytes, iterations, [&]() { return decode_tokens(examined, tokens); });
+  run("scalar", bytes, iterations, [&]() { return decode_scalar(compact, scalar); });
+  run("vector", bytes, iterations, [&]() {
+    return mi_decode_hex(compact.data(), compact.size(), vectorized.data());
+  });
+  return 0;
+}
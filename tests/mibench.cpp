@@ -0,0 +1,110 @@
+// Microbenchmark for the GDB/MI record parser.
+// Parses a recorded GDB/MI session (plus synthesized large replies) over and
+// over, once with the in-place parser gg uses and once with the
+// split()/stringstream tokenizing gg used to scrape CLI output with, and
+// reports the throughput of each in MB/s.
+//
+// Usage: mibench [trace.mi] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/mi.hpp"
+#include "bench.hpp"
+
+#define MIBENCH_DEFAULT_TRACE "tests/traces/session.mi"
+#define MIBENCH_DEFAULT_ITERATIONS 200
+#define MIBENCH_MEMORY_BYTES (64 * 1024)
+#define MIBENCH_LOCALS 2000
+
+// Builds a -data-read-memory-bytes reply the size of a large stack read.
+std::string memory_reply() {
+  static const char * digits = "0123456789abcdef";
+  std::string contents;
+  for (size_t i = 0; i < MIBENCH_MEMORY_BYTES; i++) {
+    contents += digits[(i * 7) >> 4 & 15];
+    contents += digits[(i * 7) & 15];
+  }
+  return "20^done,memory=[{begin=\"0x00007fffffffe490\",offset=\"0x0000000000000000\","
+    "end=\"0x00007ffffffff490\",contents=\"" + contents + "\"}]\n(gdb)\n";
+}
+
+// Builds a -stack-list-locals reply for a frame with many locals.
+std::string locals_reply() {
+  std::string reply = "21^done,locals=[";
+  for (size_t i = 0; i < MIBENCH_LOCALS; i++) {
+    if (i) {
+      reply += ",";
+    }
+    reply += "{name=\"local_" + std::to_string(i) + "\",value=\"{x = " + 
+      std::to_string(i) + ", name = 0x4006f4 \\\"item\\\\t" + std::to_string(i) + "\\\"}\"}";
+  }
+  return reply + "]\n(gdb)\n";
+}
+
+// Tokenizes every line into fields and name/value pairs the way the
+// split() helpers did, counting the fields so the work isn't optimized out.
+size_t parse_with_split(const std::string & trace) {
+  size_t fields = 0;
+  for (std::string line : split(trace, '\n')) {
+    for (std::string field : split(line, ',')) {
+      fields += split(field, '=').size();
+    }
+  }
+  return fields;
+}
+
+// Parses every line in place, the way gg parses its read buffer, counting
+// the records so the work isn't optimized out.
+size_t parse_in_place(const std::string & trace, std::vector<char> & buffer, MIArena & arena) {
+  buffer.assign(trace.begin(), trace.end());
+  size_t records = 0;
+  char * line = buffer.data();
+  char * end = line + buffer.size();
+  while (line < end) {
+    char * newline = (char *) memchr(line, '\n', end - line);
+    size_t length = newline ? newline - line : end - line;
+    MIRecord record;
+    arena.reset();
+    records += mi_parse_record(line, length, arena, record);
+    line += length + 1;
+  }
+  return records;
+}
+
+int main(int argc, char ** argv) {
+  const char * path = argc > 1 ? argv[1] : MIBENCH_DEFAULT_TRACE;
+  long iterations = argc > 2 ? atol(argv[2]) : MIBENCH_DEFAULT_ITERATIONS;
+
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "mibench: cannot open " << path << std::endl;
+    return 1;
+  }
+  std::stringstream recorded;
+  recorded << file.rdbuf();
+
+  // Make sure every record of the trace actually parses
+  std::string session = recorded.str();
+  std::vector<char> buffer;
+  MIArena arena;
+  size_t lines = split(session, '\n').size();
+  size_t records = parse_in_place(session, buffer, arena);
+  if (records != lines) {
+    std::cerr << "mibench: only " << records << " of " << lines << " records parsed" << std::endl;
+    return 1;
+  }
+
+  std::string trace = session + memory_reply() + locals_reply();
+  printf("%zu bytes per iteration, %ld iterations\n", trace.size(), iterations);
+  run("split", trace.size(), iterations, [&]() { return parse_with_split(trace); });
+  run("in-place", trace.size(), iterations, [&]() { return parse_in_place(trace, buffer, arena); });
+  printf("arena blocks allocated: %ld\n", arena.get_allocations());
+  return 0;
+}
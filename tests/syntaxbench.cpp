@@ -0,0 +1,69 @@
+// Microbenchmark for the syntax highlighter.
+// Lexes a source file (gg's own by default) repeated until it is as long
+// as a large generated file, the way the highlighter's thread lexes a file
+// once it is first shown, and reports the throughput in MB of source per 
+// second.
+//
+// Usage: syntaxbench [source] [lines] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/syntax.hpp"
+#include "bench.hpp"
+
+#define SYNTAXBENCH_DEFAULT_SOURCE "src/gdb.cpp"
+#define SYNTAXBENCH_DEFAULT_LINES 100000
+#define SYNTAXBENCH_DEFAULT_ITERATIONS 10
+
+// Lexes every line into a fresh set of lines, counting the spans so the
+// work isn't optimized out.
+size_t lex_lines(const std::vector<std::string> & lines) {
+  SyntaxLines lexed;
+  for (size_t i = 0; i < lines.size(); i++) {
+    lexed.add_c_line(lines[i].data(), lines[i].size());
+  }
+  size_t spans = 0;
+  for (long line = 1; line <= lexed.get_line_count(); line++) {
+    size_t count;
+    lexed.get_line(line, count);
+    spans += count;
+  }
+  return spans;
+}
+
+int main(int argc, char ** argv) {
+  const char * path = argc > 1 ? argv[1] : SYNTAXBENCH_DEFAULT_SOURCE;
+  long line_count = argc > 2 ? atol(argv[2]) : SYNTAXBENCH_DEFAULT_LINES;
+  long iterations = argc > 3 ? atol(argv[3]) : SYNTAXBENCH_DEFAULT_ITERATIONS;
+
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "syntaxbench: cannot open " << path << std::endl;
+    return 1;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::vector<std::string> source = split(contents.str(), '\n');
+  if (source.empty()) {
+    std::cerr << "syntaxbench: " << path << " is empty" << std::endl;
+    return 1;
+  }
+
+  // Repeat the file until it has as many lines as asked for
+  std::vector<std::string> lines;
+  size_t bytes = 0;
+  for (long i = 0; i < line_count; i++) {
+    lines.push_back(source[i % source.size()]);
+    bytes += lines.back().size() + 1;
+  }
+
+  printf("%ld lines, %zu bytes per iteration, %ld iterations\n", line_count, bytes, iterations);
+  run("lex", bytes, iterations, [&]() { return lex_lines(lines); });
+  return 0;
+}